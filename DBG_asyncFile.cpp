@@ -0,0 +1,201 @@
+/**
+* @Filename: DBG_asyncFile.cpp
+* @Author:   Ben Sokol <Ben>
+* @Email:    ben@bensokol.com
+* @Created:  October 14th, 2026 [3:58pm]
+* @Modified: October 14th, 2026 [3:58pm]
+* @Version:  1.0.0
+*
+* Copyright (C) 2019 by Ben Sokol. All Rights Reserved.
+*/
+
+#include <cerrno>   // errno, EINTR, EINPROGRESS
+#include <cstddef>  // size_t
+#include <cstring>  // memcpy, memset
+
+#include <algorithm>  // std::max, std::min
+#include <memory>     // std::unique_ptr
+#include <string>     // std::string
+
+#include "DBG_asyncFile.hpp"
+
+#if __has_include(<aio.h>) && __has_include(<unistd.h>)
+  #include <aio.h>       // aio_write, aio_error, aio_return, aio_suspend
+  #include <fcntl.h>     // open
+  #include <sys/stat.h>  // fstat
+  #include <unistd.h>    // pwrite, close
+  #define DBG_OUT_HAS_AIO
+#endif
+
+namespace DBG {
+  struct asyncFile::buffer {
+    std::unique_ptr<char[]> data;
+    size_t size = 0;
+    bool inFlight = false;
+#ifdef DBG_OUT_HAS_AIO
+    struct aiocb request;
+#endif
+  };
+
+
+  asyncFile::asyncFile() : mFD(-1), mOffset(0), mBufferSize(0), mCurrent(0), mFailed(false) {
+  }
+
+
+  asyncFile::~asyncFile() {
+    close();
+  }
+
+
+  bool asyncFile::open(const std::string &aPath, size_t aBufferSize, size_t aBuffers) {
+    close();
+
+#ifdef DBG_OUT_HAS_AIO
+    mFD = ::open(aPath.c_str(), O_WRONLY | O_CREAT, 0644);
+    if (mFD < 0) {
+      return false;
+    }
+
+    struct stat info;
+    if (fstat(mFD, &info) != 0) {
+      close();
+      return false;
+    }
+
+    mOffset = static_cast<size_t>(info.st_size);
+    mBufferSize = std::max<size_t>(aBufferSize, 1);
+    mCurrent = 0;
+    mFailed = false;
+    for (size_t i = 0; i < std::max<size_t>(aBuffers, 2); ++i) {
+      mBuffers.emplace_back(new buffer());
+      mBuffers.back()->data.reset(new char[mBufferSize]);
+    }
+    return true;
+#else
+    (void)aPath;
+    (void)aBufferSize;
+    (void)aBuffers;
+    return false;
+#endif
+  }
+
+
+  bool asyncFile::isOpen() const {
+    return mFD >= 0;
+  }
+
+
+  bool asyncFile::write(const char *aData, size_t aSize) {
+    if (mFD < 0) {
+      return false;
+    }
+
+    while (aSize > 0) {
+      buffer &current = *mBuffers[mCurrent];
+      size_t count = std::min(aSize, mBufferSize - current.size);
+      std::memcpy(current.data.get() + current.size, aData, count);
+      current.size += count;
+      aData += count;
+      aSize -= count;
+
+      if (current.size == mBufferSize) {
+        submit();
+      }
+    }
+
+    return !mFailed;
+  }
+
+
+  void asyncFile::flush() {
+    if (mFD >= 0 && mBuffers[mCurrent]->size != 0) {
+      submit();
+    }
+  }
+
+
+  void asyncFile::sync() {
+    for (auto &pending : mBuffers) {
+      complete(*pending);
+    }
+  }
+
+
+  void asyncFile::close() {
+#ifdef DBG_OUT_HAS_AIO
+    if (mFD >= 0) {
+      flush();
+      sync();
+      ::close(mFD);
+      mFD = -1;
+    }
+#endif
+    mBuffers.clear();
+    mOffset = 0;
+  }
+
+
+  size_t asyncFile::size() const {
+    return mFD >= 0 ? mOffset + mBuffers[mCurrent]->size : 0;
+  }
+
+
+  void asyncFile::submit() {
+#ifdef DBG_OUT_HAS_AIO
+    buffer &current = *mBuffers[mCurrent];
+    std::memset(&current.request, 0, sizeof(current.request));
+    current.request.aio_fildes = mFD;
+    current.request.aio_buf = current.data.get();
+    current.request.aio_nbytes = current.size;
+    current.request.aio_offset = static_cast<off_t>(mOffset);
+    current.request.aio_sigevent.sigev_notify = SIGEV_NONE;
+
+    if (aio_write(&current.request) == 0) {
+      current.inFlight = true;
+    }
+    else {
+      // Out of AIO resources, write synchronously instead
+      size_t written = 0;
+      while (written < current.size) {
+        ssize_t result = pwrite(mFD, current.data.get() + written, current.size - written,
+                                static_cast<off_t>(mOffset + written));
+        if (result < 0 && errno == EINTR) {
+          continue;
+        }
+        if (result <= 0) {
+          mFailed = true;
+          break;
+        }
+        written += static_cast<size_t>(result);
+      }
+      current.size = 0;
+    }
+    mOffset += current.request.aio_nbytes;
+#endif
+
+    mCurrent = (mCurrent + 1) % mBuffers.size();
+    complete(*mBuffers[mCurrent]);
+  }
+
+
+  void asyncFile::complete(buffer &aBuffer) {
+#ifdef DBG_OUT_HAS_AIO
+    if (!aBuffer.inFlight) {
+      return;
+    }
+
+    const struct aiocb *requests[] = {&aBuffer.request};
+    while (aio_error(&aBuffer.request) == EINPROGRESS) {
+      aio_suspend(requests, 1, nullptr);
+    }
+
+    // Short writes to a regular file only happen when the disk is full
+    if (aio_return(&aBuffer.request) != static_cast<ssize_t>(aBuffer.size)) {
+      mFailed = true;
+    }
+
+    aBuffer.inFlight = false;
+#endif
+    aBuffer.size = 0;
+  }
+}  // namespace DBG
@@ -0,0 +1,82 @@
+/**
+* @Filename: DBG_asyncFile.hpp
+* @Author:   Ben Sokol <Ben>
+* @Email:    ben@bensokol.com
+* @Created:  October 14th, 2026 [3:58pm]
+* @Modified: October 14th, 2026 [3:58pm]
+* @Version:  1.0.0
+*
+* Copyright (C) 2019 by Ben Sokol. All Rights Reserved.
+*/
+
+#ifndef DBG_ASYNC_FILE_HPP
+#define DBG_ASYNC_FILE_HPP
+
+#include <cstddef>  // size_t
+
+#include <memory>  // std::unique_ptr
+#include <string>  // std::string
+#include <vector>  // std::vector
+
+// Size of each write buffer
+#ifndef DBG_OUT_AIO_BUFFER_SIZE
+  #define DBG_OUT_AIO_BUFFER_SIZE (1024 * 1024)
+#endif
+
+// Buffers which may be filled or in flight at the same time, at least 2
+#ifndef DBG_OUT_AIO_BUFFERS
+  #define DBG_OUT_AIO_BUFFERS 4
+#endif
+
+namespace DBG {
+  // Log file written with POSIX asynchronous I/O.
+  // Data is copied into one buffer while the buffers submitted before it are written by the kernel,
+  // so the caller only blocks when every buffer is still in flight.
+  class asyncFile {
+  public:
+    asyncFile();
+    ~asyncFile();
+
+    asyncFile(const asyncFile &) = delete;
+    asyncFile &operator=(const asyncFile &) = delete;
+
+    // Appends to aPath, creating it if needed. Returns false if AIO is unavailable or the file can not be opened.
+    bool open(const std::string &aPath,
+              size_t aBufferSize = DBG_OUT_AIO_BUFFER_SIZE,
+              size_t aBuffers = DBG_OUT_AIO_BUFFERS);
+    bool isOpen() const;
+
+    // Returns false if the file is not open or an earlier write failed
+    bool write(const char *aData, size_t aSize);
+
+    // Submits the partially filled buffer without waiting for it
+    void flush();
+
+    // Waits until every submitted write has completed
+    void sync();
+
+    // Writes everything and closes the file
+    void close();
+
+    // Bytes written to the file, including those still in flight
+    size_t size() const;
+
+  private:
+    struct buffer;
+
+    // Submits the current buffer and makes the next one current, waiting for it if it is still in flight
+    void submit();
+
+    // Waits for aBuffer's write and empties it
+    void complete(buffer &aBuffer);
+
+    int mFD;
+    size_t mOffset;  // File offset of the current buffer
+    size_t mBufferSize;
+    size_t mCurrent;
+    bool mFailed;
+    std::vector<std::unique_ptr<buffer>> mBuffers;
+  };
+}  // namespace DBG
+
+#endif
@@ -0,0 +1,198 @@
+/**
+* @Filename: DBG_bench.cpp
+* @Author:   Ben Sokol <Ben>
+* @Email:    ben@bensokol.com
+* @Created:  October 14th, 2026 [3:36pm]
+* @Modified: October 14th, 2026 [3:36pm]
+* @Version:  1.0.0
+*
+* Copyright (C) 2019 by Ben Sokol. All Rights Reserved.
+*/
+
+// Benchmarks for DBG::out. Build as its own executable together with every DBG_*.cpp file except DBG_decode.cpp
+// and DBG_test.cpp.
+// Results are written to stdout as one JSON object per line, log files go to ./logs as usual.
+//
+//   DBG_bench [--samples <n>] [--messages <n>] [--threads <max>]
+
+#include <cstddef>  // size_t
+#include <cstdint>  // uint64_t
+
+#include <algorithm>  // std::sort
+#include <chrono>     // std::chrono::steady_clock
+#include <iostream>   // std::cout, std::cerr
+#include <memory>     // std::make_shared
+#include <string>     // std::string
+#include <thread>     // std::thread
+#include <vector>     // std::vector
+
+#include "DBG_out.hpp"
+
+namespace {
+  using clock = std::chrono::steady_clock;
+
+  // Discards everything, isolates the cost of the logger from the cost of the output
+  class nullSink : public DBG::sink {
+  public:
+    void write(const char *, size_t) override {
+    }
+  };
+
+
+  void usage() {
+    std::cerr << "Usage: DBG_bench [--samples <n>] [--messages <n>] [--threads <max>]\n";
+  }
+
+
+  double nanoseconds(clock::duration aDuration) {
+    return std::chrono::duration<double, std::nano>(aDuration).count();
+  }
+
+
+  double percentile(const std::vector<double> &_sorted, double aPercentile) {
+    size_t index = static_cast<size_t>(aPercentile / 100.0 * static_cast<double>(_sorted.size() - 1));
+    return _sorted[index];
+  }
+
+
+  // Log file only, so that stderr does not dominate the results
+  void reset(DBG::out &aOut) {
+    aOut.wait();
+    aOut.enable();
+    aOut.osDisable();
+    aOut.ofsEnable();
+    aOut.newline(true);
+    aOut.verbosity(0);
+    aOut.fileMode(DBG::out::FILE_MODE::STREAM);
+    aOut.logFormat(DBG::out::LOG_FORMAT::TEXT);
+    aOut.flush(DBG::out::FLUSH_POLICY::MANUAL);
+  }
+
+
+  // Time spent by the caller in a single call, the worker runs concurrently
+  template <typename Function>
+  void latency(DBG::out &aOut, const char *aMethod, size_t aSamples, Function &&aFunction) {
+    reset(aOut);
+    std::vector<double> times;
+    times.reserve(aSamples);
+
+    for (size_t i = 0; i < aSamples; ++i) {
+      auto start = clock::now();
+      aFunction(i);
+      times.push_back(nanoseconds(clock::now() - start));
+    }
+    aOut.wait();
+
+    std::sort(times.begin(), times.end());
+    std::cout << "{\"benchmark\":\"latency\",\"method\":\"" << aMethod << "\",\"samples\":" << aSamples
+              << ",\"p50_ns\":" << percentile(times, 50) << ",\"p99_ns\":" << percentile(times, 99)
+              << ",\"p99.9_ns\":" << percentile(times, 99.9) << "}\n";
+  }
+
+
+  // Messages per second from the first call until the worker has written everything
+  double throughput(DBG::out &aOut, size_t aMessages, size_t aThreads) {
+    auto start = clock::now();
+    std::vector<std::thread> producers;
+    for (size_t t = 0; t < aThreads; ++t) {
+      producers.emplace_back([aMessages, aThreads, t]() {
+        for (size_t i = t; i < aMessages; i += aThreads) {
+          DBG_print("throughput ", i, " ", 0.5);
+        }
+      });
+    }
+    for (auto &producer : producers) {
+      producer.join();
+    }
+    aOut.wait();
+    return static_cast<double>(aMessages) / std::chrono::duration<double>(clock::now() - start).count();
+  }
+
+
+  void sinkThroughput(DBG::out &aOut, const char *aSink, size_t aMessages) {
+    std::cout << "{\"benchmark\":\"throughput\",\"sink\":\"" << aSink << "\",\"messages\":" << aMessages
+              << ",\"messages_per_sec\":" << throughput(aOut, aMessages, 1) << "}\n";
+  }
+}  // namespace
+
+
+int main(int argc, char **argv) {
+  size_t samples = 100000;
+  size_t messages = 1000000;
+  size_t threads = std::max(1u, std::thread::hardware_concurrency());
+
+  try {
+    for (int i = 1; i < argc; ++i) {
+      std::string arg = argv[i];
+      if (arg == "--samples" && i + 1 < argc) {
+        samples = std::stoul(argv[++i]);
+      }
+      else if (arg == "--messages" && i + 1 < argc) {
+        messages = std::stoul(argv[++i]);
+      }
+      else if (arg == "--threads" && i + 1 < argc) {
+        threads = std::stoul(argv[++i]);
+      }
+      else {
+        usage();
+        return 1;
+      }
+    }
+  }
+  catch (const std::exception &) {
+    usage();
+    return 1;
+  }
+
+  if (samples == 0 || messages == 0 || threads == 0) {
+    usage();
+    return 1;
+  }
+
+  DBG::out &o = DBG::out::instance();
+
+  latency(o, "print", samples, [](size_t i) { DBG_print("latency ", i, " ", 0.5); });
+  latency(o, "printf", samples, [](size_t i) { DBG_printf("latency ", i, " ", 0.5); });
+  latency(o, "write", samples, [](size_t i) { DBG_write(true, true, false, true, "latency ", i, " ", 0.5); });
+
+  // Calls above the runtime verbosity, averaged since they are too short to time individually
+  reset(o);
+  auto start = clock::now();
+  for (size_t i = 0; i < messages; ++i) {
+    DBG_printv(5, "filtered ", i);
+  }
+  std::cout << "{\"benchmark\":\"filtered\",\"calls\":" << messages
+            << ",\"ns_per_call\":" << nanoseconds(clock::now() - start) / static_cast<double>(messages) << "}\n";
+
+  reset(o);
+  sinkThroughput(o, "file", messages);
+
+  reset(o);
+  if (o.fileMode(DBG::out::FILE_MODE::MMAP)) {
+    sinkThroughput(o, "mmap", messages);
+  }
+
+  reset(o);
+  if (o.fileMode(DBG::out::FILE_MODE::AIO)) {
+    sinkThroughput(o, "aio", messages);
+  }
+
+  reset(o);
+  o.logFormat(DBG::out::LOG_FORMAT::BINARY);
+  sinkThroughput(o, "binary", messages);
+
+  reset(o);
+  o.ofsDisable();
+  DBG::sinkMask null = o.addSink(std::make_shared<nullSink>());
+  sinkThroughput(o, "null", messages);
+
+  // Producer scaling, measured against the null sink so that the file system is not the bottleneck
+  for (size_t t = 1; t <= threads; t *= 2) {
+    std::cout << "{\"benchmark\":\"scaling\",\"threads\":" << t << ",\"messages\":" << messages
+              << ",\"messages_per_sec\":" << throughput(o, messages, t) << "}\n";
+  }
+  o.removeSink(null);
+
+  o.shutdown();
+  return 0;
+}
@@ -0,0 +1,155 @@
+/**
+* @Filename: DBG_binaryLog.cpp
+* @Author:   Ben Sokol <Ben>
+* @Email:    ben@bensokol.com
+* @Created:  October 14th, 2026 [3:21pm]
+* @Modified: October 14th, 2026 [3:21pm]
+* @Version:  1.0.0
+*
+* Copyright (C) 2019 by Ben Sokol. All Rights Reserved.
+*/
+
+#include <cstdint>  // uint8_t, uint16_t, uint32_t, uint64_t, int64_t
+#include <cstring>  // memcmp, strlen
+
+#include <chrono>       // std::chrono::nanoseconds
+#include <istream>      // std::istream
+#include <string>       // std::string
+#include <string_view>  // std::string_view
+#include <utility>      // std::move
+
+#include "DBG_binaryLog.hpp"
+
+namespace DBG {
+  namespace {
+    template <typename T>
+    void put(std::string &aOutput, const T &aValue) {
+      aOutput.append(reinterpret_cast<const char *>(&aValue), sizeof(T));
+    }
+
+    // Location strings are limited to 64KiB
+    void putString16(std::string &aOutput, const char *aStr) {
+      size_t length = std::strlen(aStr);
+      uint16_t size = static_cast<uint16_t>(length > UINT16_MAX ? UINT16_MAX : length);
+      put(aOutput, size);
+      aOutput.append(aStr, size);
+    }
+  }  // namespace
+
+
+  binaryWriter::binaryWriter() {
+  }
+
+
+  void binaryWriter::begin(std::string &aOutput) {
+    mSites.clear();
+    aOutput.append(binaryLog::MAGIC, sizeof(binaryLog::MAGIC));
+    put(aOutput, binaryLog::VERSION);
+  }
+
+
+  void binaryWriter::append(std::string &aOutput,
+                            const callSite &aSite,
+                            std::chrono::system_clock::time_point aTime,
+                            uint64_t aThread,
+                            uint8_t aVerbosity,
+                            uint8_t aFlags,
+                            std::string_view aBody) {
+    auto result = mSites.emplace(&aSite, static_cast<uint32_t>(mSites.size()));
+    uint32_t id = result.first->second;
+
+    if (result.second) {
+      aOutput += static_cast<char>(binaryLog::SITE);
+      put(aOutput, id);
+      put(aOutput, static_cast<uint32_t>(aSite.line));
+      putString16(aOutput, aSite.file);
+      putString16(aOutput, aSite.function);
+    }
+
+    aOutput += static_cast<char>(binaryLog::MESSAGE);
+    put(aOutput, id);
+    put(aOutput,
+        static_cast<int64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(aTime.time_since_epoch()).count()));
+    put(aOutput, aThread);
+    put(aOutput, aVerbosity);
+    put(aOutput, aFlags);
+    put(aOutput, static_cast<uint32_t>(aBody.size()));
+    aOutput += aBody;
+  }
+
+
+  template <typename T>
+  bool binaryReader::read(T &aValue) {
+    return static_cast<bool>(mInput.read(reinterpret_cast<char *>(&aValue), sizeof(T)));
+  }
+
+
+  binaryReader::binaryReader(std::istream &aInput) : mInput(aInput), mValid(false) {
+    char magic[sizeof(binaryLog::MAGIC)];
+    uint16_t version;
+    if (mInput.read(magic, sizeof(magic)) && std::memcmp(magic, binaryLog::MAGIC, sizeof(magic)) == 0
+        && read(version)) {
+      mValid = version == binaryLog::VERSION;
+    }
+  }
+
+
+  bool binaryReader::valid() const {
+    return mValid;
+  }
+
+
+  bool binaryReader::next(binaryLog::message &aMessage) {
+    if (!mValid) {
+      return false;
+    }
+
+    for (;;) {
+      uint8_t type;
+      if (!read(type)) {
+        return false;
+      }
+
+      if (type == binaryLog::SITE) {
+        uint32_t id;
+        binaryLog::site site;
+        uint16_t fileSize;
+        uint16_t functionSize;
+        if (!read(id) || !read(site.line) || !read(fileSize) || !readString(site.file, fileSize)
+            || !read(functionSize) || !readString(site.function, functionSize)) {
+          return false;
+        }
+        if (id >= mSites.size()) {
+          mSites.resize(id + 1);
+        }
+        mSites[id] = std::move(site);
+      }
+      else if (type == binaryLog::MESSAGE) {
+        uint32_t size;
+        if (!read(aMessage.site) || !read(aMessage.time) || !read(aMessage.thread) || !read(aMessage.verbosity)
+            || !read(aMessage.flags) || !read(size) || !readString(aMessage.body, size)) {
+          return false;
+        }
+        if (aMessage.site >= mSites.size()) {
+          mSites.resize(aMessage.site + 1);
+        }
+        return true;
+      }
+      else {
+        // Unknown record, the rest of the file can not be parsed
+        return false;
+      }
+    }
+  }
+
+
+  const binaryLog::site &binaryReader::site(uint32_t aId) const {
+    return mSites[aId];
+  }
+
+
+  bool binaryReader::readString(std::string &aValue, size_t aSize) {
+    aValue.resize(aSize);
+    return aSize == 0 || static_cast<bool>(mInput.read(&aValue[0], static_cast<std::streamsize>(aSize)));
+  }
+}  // namespace DBG
@@ -0,0 +1,111 @@
+/**
+* @Filename: DBG_binaryLog.hpp
+* @Author:   Ben Sokol <Ben>
+* @Email:    ben@bensokol.com
+* @Created:  October 14th, 2026 [3:21pm]
+* @Modified: October 14th, 2026 [3:21pm]
+* @Version:  1.0.0
+*
+* Copyright (C) 2019 by Ben Sokol. All Rights Reserved.
+*/
+
+#ifndef DBG_BINARY_LOG_HPP
+#define DBG_BINARY_LOG_HPP
+
+#include <cstddef>  // size_t
+#include <cstdint>  // uint8_t, uint32_t, uint64_t, int64_t
+
+#include <chrono>         // std::chrono::system_clock::time_point
+#include <istream>        // std::istream
+#include <string>         // std::string
+#include <string_view>    // std::string_view
+#include <unordered_map>  // std::unordered_map
+#include <vector>         // std::vector
+
+#include "DBG_callSite.hpp"
+
+// Binary log layout, all integers are in host byte order:
+//   header:  "DBGLOG" followed by a uint16_t version
+//   site:    'S', uint32_t id, uint32_t line, uint16_t size + file, uint16_t size + function
+//   message: 'M', uint32_t site id, int64_t nanoseconds since epoch, uint64_t thread,
+//            uint8_t verbosity, uint8_t flags, uint32_t size + body
+// A site record is written before the first message which uses it, so each file is self-contained.
+
+namespace DBG {
+  namespace binaryLog {
+    constexpr char MAGIC[6] = {'D', 'B', 'G', 'L', 'O', 'G'};
+    constexpr uint16_t VERSION = 1;
+
+    constexpr uint8_t SITE = 'S';
+    constexpr uint8_t MESSAGE = 'M';
+
+    // Message flags
+    constexpr uint8_t TIMESTAMP = 1;
+    constexpr uint8_t LOCATION = 2;
+    constexpr uint8_t NEWLINE = 4;  // The text line ends in '\n', see out::newline()
+
+    struct site {
+      uint32_t line;
+      std::string file;
+      std::string function;
+    };
+
+    struct message {
+      uint32_t site;
+      int64_t time;
+      uint64_t thread;
+      uint8_t verbosity;
+      uint8_t flags;
+      std::string body;
+    };
+  }  // namespace binaryLog
+
+
+  // Encodes messages, call begin() at the start of every file
+  class binaryWriter {
+  public:
+    binaryWriter();
+
+    // Appends the file header and forgets previously written sites
+    void begin(std::string &aOutput);
+
+    void append(std::string &aOutput,
+                const callSite &aSite,
+                std::chrono::system_clock::time_point aTime,
+                uint64_t aThread,
+                uint8_t aVerbosity,
+                uint8_t aFlags,
+                std::string_view aBody);
+
+  private:
+    // Call sites are static, so their address identifies them
+    std::unordered_map<const callSite *, uint32_t> mSites;
+  };
+
+
+  // Decodes a binary log
+  class binaryReader {
+  public:
+    explicit binaryReader(std::istream &aInput);
+
+    // False if the input does not start with a binary log header
+    bool valid() const;
+
+    // Reads the next message, returns false at the end of the input or on a truncated record
+    bool next(binaryLog::message &aMessage);
+
+    // Site of a message returned by next()
+    const binaryLog::site &site(uint32_t aId) const;
+
+  private:
+    template <typename T>
+    bool read(T &aValue);
+    bool readString(std::string &aValue, size_t aSize);
+
+    std::istream &mInput;
+    bool mValid;
+    std::vector<binaryLog::site> mSites;
+  };
+}  // namespace DBG
+
+#endif
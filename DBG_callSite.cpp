@@ -0,0 +1,166 @@
+/**
+* @Filename: DBG_callSite.cpp
+* @Author:   Ben Sokol <Ben>
+* @Email:    ben@bensokol.com
+* @Created:  October 14th, 2026 [3:24pm]
+* @Modified: October 14th, 2026 [3:24pm]
+* @Version:  1.0.0
+*
+* Copyright (C) 2019 by Ben Sokol. All Rights Reserved.
+*/
+
+#include <cstddef>  // size_t
+#include <cstring>  // strcmp
+
+#include <atomic>      // std::atomic
+#include <functional>  // std::hash
+#include <map>         // std::map
+#include <mutex>       // std::mutex, std::unique_lock
+#include <string>      // std::string
+#include <tuple>       // std::tuple
+
+#include "DBG_callSite.hpp"
+
+namespace DBG {
+  namespace {
+    // Open addressing table of interned sites. Slots are only ever filled, so lookups need no lock.
+    std::atomic<callSite *> interned[DBG_OUT_INTERNED_SITES];
+
+    // Slots a lookup visits before it falls back to the locked map
+    constexpr size_t MAX_PROBES = 64;
+
+    // A site for a location given as std::string, which owns copies of the names
+    struct ownedSite {
+      ownedSite(const std::string &aFile, const std::string &aFunction, int aLine) :
+          file(aFile),
+          function(aFunction),
+          site(file.c_str(), function.c_str(), aLine) {
+      }
+
+      const std::string file;
+      const std::string function;
+      callSite site;
+    };
+
+    size_t combine(size_t aHash, size_t aValue) {
+      return aHash ^ (aValue + 0x9e3779b97f4a7c15ull + (aHash << 6) + (aHash >> 2));
+    }
+
+    // Finds the site for which aMatches(callSite &) is true, or publishes the one made by aCreate().
+    // A site which lost the race for a slot is passed to aDestroy. Returns nullptr if every probed slot is taken.
+    template <typename Matches, typename Create, typename Destroy>
+    callSite *find(size_t aHash, Matches &&aMatches, Create &&aCreate, Destroy &&aDestroy) {
+      callSite *created = nullptr;
+      callSite *found = nullptr;
+      for (size_t i = 0; i < MAX_PROBES && i < DBG_OUT_INTERNED_SITES; ++i) {
+        std::atomic<callSite *> &slot = interned[(aHash + i) % DBG_OUT_INTERNED_SITES];
+        callSite *site = slot.load(std::memory_order_acquire);
+        if (site == nullptr) {
+          if (created == nullptr) {
+            created = aCreate();
+          }
+          if (slot.compare_exchange_strong(site, created, std::memory_order_acq_rel, std::memory_order_acquire)) {
+            created->registerSite();
+            return created;
+          }
+        }
+        // Another thread may have published the same location
+        if (aMatches(*site)) {
+          found = site;
+          break;
+        }
+      }
+      if (created != nullptr) {
+        aDestroy(created);
+      }
+      return found;
+    }
+  }  // namespace
+
+
+  callSite &callSite::intern(const char *aFile, const char *aFunction, int aLine) {
+    size_t hash = combine(combine(std::hash<const void *>()(aFile), std::hash<const void *>()(aFunction)),
+                          static_cast<size_t>(aLine));
+    callSite *site = find(
+      hash,
+      [&](const callSite &aSite) {
+        return aSite.file == aFile && aSite.function == aFunction && aSite.line == aLine;
+      },
+      [&]() {
+        return new callSite(aFile, aFunction, aLine);
+      },
+      [](callSite *aSite) {
+        delete aSite;
+      });
+    if (site != nullptr) {
+      return *site;
+    }
+
+    static std::mutex mutex;
+    static std::map<std::tuple<const char *, const char *, int>, callSite *> sites;
+    std::unique_lock<std::mutex> lock(mutex);
+    callSite *&overflow = sites[std::make_tuple(aFile, aFunction, aLine)];
+    if (overflow == nullptr) {
+      overflow = new callSite(aFile, aFunction, aLine);
+      overflow->registerSite();
+    }
+    return *overflow;
+  }
+
+
+  callSite &callSite::intern(const std::string &aFile, const std::string &aFunction, int aLine) {
+    size_t hash = combine(combine(std::hash<std::string>()(aFile), std::hash<std::string>()(aFunction)),
+                          static_cast<size_t>(aLine));
+    ownedSite *owned = nullptr;
+    callSite *site = find(
+      hash,
+      [&](const callSite &aSite) {
+        return aSite.line == aLine && std::strcmp(aSite.file, aFile.c_str()) == 0
+               && std::strcmp(aSite.function, aFunction.c_str()) == 0;
+      },
+      [&]() {
+        owned = new ownedSite(aFile, aFunction, aLine);
+        return &owned->site;
+      },
+      [&](callSite *) {
+        delete owned;
+      });
+    if (site != nullptr) {
+      return *site;
+    }
+
+    static std::mutex mutex;
+    static std::map<std::tuple<std::string, std::string, int>, callSite *> sites;
+    std::unique_lock<std::mutex> lock(mutex);
+    callSite *&overflow = sites[std::make_tuple(aFile, aFunction, aLine)];
+    if (overflow == nullptr) {
+      overflow = &(new ownedSite(aFile, aFunction, aLine))->site;
+      overflow->registerSite();
+    }
+    return *overflow;
+  }
+
+
+  void callSite::registerSlow() {
+    bool expected = false;
+    if (!mRegistered.compare_exchange_strong(expected, true, std::memory_order_relaxed)) {
+      return;
+    }
+
+    mNext = head().load(std::memory_order_relaxed);
+    while (!head().compare_exchange_weak(mNext, this, std::memory_order_release, std::memory_order_relaxed)) {
+    }
+  }
+
+
+  std::atomic<callSite *> &callSite::head() {
+    static std::atomic<callSite *> first(nullptr);
+    return first;
+  }
+
+
+  std::atomic<bool> &callSite::suppressedPending() {
+    static std::atomic<bool> pending(false);
+    return pending;
+  }
+}  // namespace DBG
@@ -0,0 +1,146 @@
+/**
+* @Filename: DBG_callSite.hpp
+* @Author:   Ben Sokol <Ben>
+* @Email:    ben@bensokol.com
+* @Created:  October 14th, 2026 [3:24pm]
+* @Modified: October 14th, 2026 [3:24pm]
+* @Version:  1.0.0
+*
+* Copyright (C) 2019 by Ben Sokol. All Rights Reserved.
+*/
+
+#ifndef DBG_CALL_SITE_HPP
+#define DBG_CALL_SITE_HPP
+
+#include <cstdint>  // uint32_t, uint64_t
+
+#include <atomic>  // std::atomic
+#include <chrono>  // std::chrono::steady_clock
+#include <string>  // std::string
+
+// Locations callSite::intern() finds without taking a lock, the rest go to a map behind a mutex
+#ifndef DBG_OUT_INTERNED_SITES
+  #define DBG_OUT_INTERNED_SITES 4096
+#endif
+
+namespace DBG {
+  // Static description of a place that logs.
+  // Every DBG_print* expansion owns one with constant initialization, queued messages only carry a pointer to it.
+  // Sites add themselves to a global registry the first time they log, and are never destroyed.
+  class callSite {
+  public:
+    constexpr callSite(const char *aFile, const char *aFunction, int aLine) :
+        file(aFile),
+        function(aFunction),
+        line(aLine),
+        mEnabled(true),
+        mRegistered(false),
+        mNext(nullptr),
+        mCount(0),
+        mWindow(0),
+        mSuppressed(0) {
+    }
+
+    callSite(const callSite &) = delete;
+    callSite &operator=(const callSite &) = delete;
+
+    bool enabled() const {
+      return mEnabled.load(std::memory_order_relaxed);
+    }
+
+    void enable(bool aEnable = true) {
+      mEnabled.store(aEnable, std::memory_order_relaxed);
+    }
+
+    // Adds the site to the registry, only the first call does any work
+    void registerSite() {
+      if (!mRegistered.load(std::memory_order_relaxed)) {
+        registerSlow();
+      }
+    }
+
+    // Rate limits, each returns true if the message should be logged and counts it as suppressed otherwise.
+    // The counters are per site, so unrelated sites never contend.
+
+    // Passes the first of every aN calls
+    bool every(uint64_t aN) {
+      return aN <= 1 || mCount.fetch_add(1, std::memory_order_relaxed) % aN == 0 || suppress();
+    }
+
+    // Passes only the first call
+    bool once() {
+      return (mCount.load(std::memory_order_relaxed) == 0 && mCount.exchange(1, std::memory_order_relaxed) == 0)
+             || suppress();
+    }
+
+    // Passes at most aPerSecond calls in each second
+    bool rate(uint32_t aPerSecond) {
+      // Current second in the high half, calls made in it in the low half
+      uint64_t second = static_cast<uint64_t>(
+        std::chrono::duration_cast<std::chrono::seconds>(std::chrono::steady_clock::now().time_since_epoch()).count());
+      uint64_t window = mWindow.load(std::memory_order_relaxed);
+      for (;;) {
+        uint64_t next = (window >> 32) == (second & 0xFFFFFFFF) ? window + 1 : second << 32 | 1;
+        if ((next & 0xFFFFFFFF) > aPerSecond) {
+          return suppress();
+        }
+        if (mWindow.compare_exchange_weak(window, next, std::memory_order_relaxed)) {
+          return true;
+        }
+      }
+    }
+
+    // Returns and resets the number of suppressed calls since the last call
+    uint64_t takeSuppressed() {
+      return mSuppressed.load(std::memory_order_relaxed) == 0 ? 0 : mSuppressed.exchange(0, std::memory_order_relaxed);
+    }
+
+    // Returns and clears a flag which is set when any site suppresses a call
+    static bool takeSuppressedPending() {
+      return suppressedPending().exchange(false);
+    }
+
+    // Calls aFunction(callSite &) for every registered site
+    template <typename Function>
+    static void forEach(Function &&aFunction) {
+      for (callSite *site = head().load(std::memory_order_acquire); site != nullptr; site = site->mNext) {
+        aFunction(*site);
+      }
+    }
+
+    // Returns a registered site for a location which has no static descriptor, such as a direct call to
+    // out::print. The DBG_print* macros do not use it. Sites are found in a lock-free table, except when
+    // a location does not fit into it. aFile and aFunction are compared by address, they have to outlive the site.
+    static callSite &intern(const char *aFile, const char *aFunction, int aLine);
+
+    // Same for names which may not outlive the call, the site keeps copies. Names are compared by content.
+    static callSite &intern(const std::string &aFile, const std::string &aFunction, int aLine);
+
+    const char *const file;
+    const char *const function;
+    const int line;
+
+  private:
+    void registerSlow();
+    static std::atomic<callSite *> &head();
+    static std::atomic<bool> &suppressedPending();
+
+    bool suppress() {
+      mSuppressed.fetch_add(1);
+      if (!suppressedPending().load()) {
+        suppressedPending().store(true);
+      }
+      return false;
+    }
+
+    std::atomic<bool> mEnabled;
+    std::atomic<bool> mRegistered;
+    callSite *mNext;  // Written once before the site is published
+
+    std::atomic<uint64_t> mCount;
+    std::atomic<uint64_t> mWindow;
+    std::atomic<uint64_t> mSuppressed;
+  };
+}  // namespace DBG
+
+#endif
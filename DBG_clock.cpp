@@ -0,0 +1,68 @@
+/**
+* @Filename: DBG_clock.cpp
+* @Author:   Ben Sokol <Ben>
+* @Email:    ben@bensokol.com
+* @Created:  October 14th, 2026 [3:52pm]
+* @Modified: October 14th, 2026 [3:52pm]
+* @Version:  1.0.0
+*
+* Copyright (C) 2019 by Ben Sokol. All Rights Reserved.
+*/
+
+#include <cstdint>  // uint64_t, int64_t
+
+#include <chrono>  // std::chrono::steady_clock, std::chrono::system_clock
+
+#include "DBG_clock.hpp"
+
+// Time spent measuring the TSC frequency on first use
+#ifndef DBG_OUT_TSC_CALIBRATION_MS
+  #define DBG_OUT_TSC_CALIBRATION_MS 10
+#endif
+
+namespace DBG {
+  namespace {
+    struct calibration {
+      double nanosecondsPerTick;
+      uint64_t ticks;                             // tscClock::now() at ...
+      std::chrono::system_clock::time_point time;  // ... this wall clock time
+    };
+
+    const calibration &calibrate() {
+      static const calibration result = []() {
+        calibration c;
+#ifdef DBG_OUT_HAS_TSC
+        auto start = std::chrono::steady_clock::now();
+        uint64_t startTicks = tscClock::now();
+        auto end = start;
+        while (end - start < std::chrono::milliseconds(DBG_OUT_TSC_CALIBRATION_MS)) {
+          end = std::chrono::steady_clock::now();
+        }
+        uint64_t endTicks = tscClock::now();
+        c.nanosecondsPerTick = std::chrono::duration<double, std::nano>(end - start).count()
+                               / static_cast<double>(endTicks - startTicks);
+#else
+        c.nanosecondsPerTick = 1.0;
+#endif
+        c.ticks = tscClock::now();
+        c.time = std::chrono::system_clock::now();
+        return c;
+      }();
+      return result;
+    }
+  }  // namespace
+
+
+  double tscClock::nanoseconds(uint64_t aTicks) {
+    return static_cast<double>(aTicks) * calibrate().nanosecondsPerTick;
+  }
+
+
+  std::chrono::system_clock::time_point tscClock::toSystem(uint64_t aTicks) {
+    const calibration &c = calibrate();
+    double offset = (static_cast<double>(aTicks) - static_cast<double>(c.ticks)) * c.nanosecondsPerTick;
+    return c.time
+           + std::chrono::duration_cast<std::chrono::system_clock::duration>(
+             std::chrono::nanoseconds(static_cast<int64_t>(offset)));
+  }
+}  // namespace DBG
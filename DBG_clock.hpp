@@ -0,0 +1,48 @@
+/**
+* @Filename: DBG_clock.hpp
+* @Author:   Ben Sokol <Ben>
+* @Email:    ben@bensokol.com
+* @Created:  October 14th, 2026 [3:52pm]
+* @Modified: October 14th, 2026 [3:52pm]
+* @Version:  1.0.0
+*
+* Copyright (C) 2019 by Ben Sokol. All Rights Reserved.
+*/
+
+#ifndef DBG_CLOCK_HPP
+#define DBG_CLOCK_HPP
+
+#include <cstdint>  // uint64_t
+
+#include <chrono>  // std::chrono::steady_clock, std::chrono::system_clock
+
+#if (defined(__x86_64__) || defined(__i386__)) && __has_include(<x86intrin.h>)
+  #include <x86intrin.h>
+  #define DBG_OUT_HAS_TSC
+#endif
+
+namespace DBG {
+  // Cheap monotonic clock for timing on the calling thread.
+  // Reads the time stamp counter where available, which is calibrated against the steady and system clocks
+  // on first use, and falls back to std::chrono::steady_clock otherwise.
+  class tscClock {
+  public:
+    static uint64_t now() {
+#ifdef DBG_OUT_HAS_TSC
+      return __rdtsc();
+#else
+      return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                                     std::chrono::steady_clock::now().time_since_epoch())
+                                     .count());
+#endif
+    }
+
+    // Length of aTicks in nanoseconds
+    static double nanoseconds(uint64_t aTicks);
+
+    // Wall clock time of a value returned by now()
+    static std::chrono::system_clock::time_point toSystem(uint64_t aTicks);
+  };
+}  // namespace DBG
+
+#endif
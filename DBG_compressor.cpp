@@ -0,0 +1,145 @@
+/**
+* @Filename: DBG_compressor.cpp
+* @Author:   Ben Sokol <Ben>
+* @Email:    ben@bensokol.com
+* @Created:  October 14th, 2026 [3:17pm]
+* @Modified: October 14th, 2026 [3:17pm]
+* @Version:  1.0.0
+*
+* Copyright (C) 2019 by Ben Sokol. All Rights Reserved.
+*/
+
+#include <cstdio>  // std::remove
+
+#include <condition_variable>  // std::condition_variable
+#include <fstream>             // std::ifstream
+#include <mutex>               // std::mutex, std::unique_lock
+#include <string>              // std::string
+#include <thread>              // std::thread
+
+#include "DBG_compressor.hpp"
+
+#if __has_include(<zlib.h>)
+  #include <zlib.h>
+  #define DBG_OUT_HAS_ZLIB
+#endif
+
+#if defined(__linux__)
+  #include <pthread.h>  // pthread_setschedparam
+  #include <sched.h>    // SCHED_IDLE
+#endif
+
+namespace DBG {
+  compressor::compressor() : mStop(false) {
+  }
+
+
+  compressor::~compressor() {
+    stop();
+  }
+
+
+  bool compressor::available() {
+#ifdef DBG_OUT_HAS_ZLIB
+    return true;
+#else
+    return false;
+#endif
+  }
+
+
+  void compressor::add(const std::string &aPath) {
+    if (!available()) {
+      return;
+    }
+
+    {
+      std::unique_lock<std::mutex> lock(mMutex);
+      if (mStop) {
+        return;
+      }
+      mFiles.push_back(aPath);
+      if (!mWorker.joinable()) {
+        mWorker = std::thread(&compressor::compressThread, this);
+      }
+    }
+    mCondition.notify_one();
+  }
+
+
+  void compressor::stop() {
+    {
+      std::unique_lock<std::mutex> lock(mMutex);
+      mStop = true;
+    }
+    mCondition.notify_one();
+    if (mWorker.joinable()) {
+      mWorker.join();
+    }
+  }
+
+
+  void compressor::compressThread() {
+#if defined(__linux__)
+    // Only run when the CPU would otherwise be idle
+    sched_param param{};
+    pthread_setschedparam(pthread_self(), SCHED_IDLE, &param);
+#endif
+
+    for (;;) {
+      std::string path;
+
+      {
+        std::unique_lock<std::mutex> lock(mMutex);
+        mCondition.wait(lock, [this]() {
+          return mStop || !mFiles.empty();
+        });
+
+        if (mStop) {
+          return;
+        }
+
+        path = mFiles.front();
+        mFiles.pop_front();
+      }
+
+      compress(path);
+    }
+  }
+
+
+  bool compressor::compress(const std::string &aPath) {
+#ifdef DBG_OUT_HAS_ZLIB
+    std::ifstream input(aPath, std::ifstream::binary);
+    if (!input.is_open()) {
+      return false;
+    }
+
+    std::string outputPath = aPath + ".gz";
+    gzFile output = gzopen(outputPath.c_str(), "wb");
+    if (output == nullptr) {
+      return false;
+    }
+
+    char buffer[64 * 1024];
+    bool success = true;
+    while (success && input) {
+      input.read(buffer, sizeof(buffer));
+      std::streamsize count = input.gcount();
+      if (count > 0 && gzwrite(output, buffer, static_cast<unsigned>(count)) != count) {
+        success = false;
+      }
+    }
+
+    success = gzclose(output) == Z_OK && success;
+    input.close();
+
+    // Keep the original if anything failed
+    std::remove(success ? aPath.c_str() : outputPath.c_str());
+    return success;
+#else
+    (void)aPath;
+    return false;
+#endif
+  }
+}  // namespace DBG
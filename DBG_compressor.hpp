@@ -0,0 +1,55 @@
+/**
+* @Filename: DBG_compressor.hpp
+* @Author:   Ben Sokol <Ben>
+* @Email:    ben@bensokol.com
+* @Created:  October 14th, 2026 [3:17pm]
+* @Modified: October 14th, 2026 [3:17pm]
+* @Version:  1.0.0
+*
+* Copyright (C) 2019 by Ben Sokol. All Rights Reserved.
+*/
+
+#ifndef DBG_COMPRESSOR_HPP
+#define DBG_COMPRESSOR_HPP
+
+#include <condition_variable>  // std::condition_variable
+#include <deque>               // std::deque
+#include <mutex>               // std::mutex
+#include <string>              // std::string
+#include <thread>              // std::thread
+
+namespace DBG {
+  // Gzips closed log files on a low priority background thread, replacing <file> with <file>.gz.
+  // zlib is used when <zlib.h> is found, which means linking with -lz. Without zlib the files are left as they are.
+  class compressor {
+  public:
+    compressor();
+    ~compressor();
+
+    compressor(const compressor &) = delete;
+    compressor &operator=(const compressor &) = delete;
+
+    // True if files can be compressed in this build
+    static bool available();
+
+    // Queues aPath for compression, the thread is started on first use
+    void add(const std::string &aPath);
+
+    // Stops the thread, files which have not been compressed yet are left uncompressed
+    void stop();
+
+  private:
+    void compressThread();
+
+    // Returns false if aPath could not be compressed
+    static bool compress(const std::string &aPath);
+
+    bool mStop;
+    std::thread mWorker;
+    std::deque<std::string> mFiles;
+    std::mutex mMutex;
+    std::condition_variable mCondition;
+  };
+}  // namespace DBG
+
+#endif
@@ -0,0 +1,104 @@
+/**
+* @Filename: DBG_configWatcher.cpp
+* @Author:   Ben Sokol <Ben>
+* @Email:    ben@bensokol.com
+* @Created:  October 14th, 2026 [4:45pm]
+* @Modified: October 14th, 2026 [4:45pm]
+* @Version:  1.0.0
+*
+* Copyright (C) 2019 by Ben Sokol. All Rights Reserved.
+*/
+
+#include <cstddef>  // size_t
+#include <cstdint>  // uintmax_t
+
+#include <chrono>        // std::chrono::milliseconds
+#include <fstream>       // std::ifstream
+#include <functional>    // std::function
+#include <iterator>      // std::istreambuf_iterator
+#include <mutex>         // std::mutex, std::unique_lock
+#include <string>        // std::string
+#include <system_error>  // std::error_code
+#include <thread>        // std::thread
+#include <utility>       // std::move
+
+#include "DBG_configWatcher.hpp"
+
+#if __has_include(<filesystem>)
+  #include <filesystem>
+  #ifndef std_filesystem
+    #define std_filesystem std::filesystem
+  #endif
+#elif __has_include(<experimental/filesystem>)
+  #include <experimental/filesystem>
+  #ifndef std_filesystem
+    #define std_filesystem std::experimental::filesystem
+  #endif
+#else
+  #error Requires std::filesystem or std::experimental::filesystem
+#endif
+
+namespace DBG {
+  configWatcher::configWatcher() : mStop(false) {
+  }
+
+
+  configWatcher::~configWatcher() {
+    stop();
+  }
+
+
+  void configWatcher::watch(const std::string &aPath,
+                            size_t aMilliseconds,
+                            std::function<void(const std::string &)> aCallback) {
+    stop();
+    mStop = false;
+    mWorker = std::thread(&configWatcher::watchThread, this, aPath, aMilliseconds, std::move(aCallback));
+  }
+
+
+  void configWatcher::stop() {
+    {
+      std::unique_lock<std::mutex> lock(mMutex);
+      mStop = true;
+    }
+    mCondition.notify_one();
+    if (mWorker.joinable()) {
+      mWorker.join();
+    }
+  }
+
+
+  void configWatcher::watchThread(std::string aPath,
+                                  size_t aMilliseconds,
+                                  std::function<void(const std::string &)> aCallback) {
+    bool seen = false;
+    std_filesystem::file_time_type lastTime;
+    uintmax_t lastSize = 0;
+
+    for (;;) {
+      // Editors often replace the file, so the size is compared as well as the modification time
+      std::error_code error;
+      auto time = std_filesystem::last_write_time(aPath, error);
+      uintmax_t size = error ? 0 : std_filesystem::file_size(aPath, error);
+
+      if (!error && (!seen || time != lastTime || size != lastSize)) {
+        std::ifstream file(aPath);
+        if (file.is_open()) {
+          std::string contents((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+          seen = true;
+          lastTime = time;
+          lastSize = size;
+          aCallback(contents);
+        }
+      }
+
+      std::unique_lock<std::mutex> lock(mMutex);
+      if (mCondition.wait_for(lock, std::chrono::milliseconds(aMilliseconds), [this]() {
+            return mStop;
+          })) {
+        return;
+      }
+    }
+  }
+}  // namespace DBG
@@ -0,0 +1,50 @@
+/**
+* @Filename: DBG_configWatcher.hpp
+* @Author:   Ben Sokol <Ben>
+* @Email:    ben@bensokol.com
+* @Created:  October 14th, 2026 [4:45pm]
+* @Modified: October 14th, 2026 [4:45pm]
+* @Version:  1.0.0
+*
+* Copyright (C) 2019 by Ben Sokol. All Rights Reserved.
+*/
+
+#ifndef DBG_CONFIG_WATCHER_HPP
+#define DBG_CONFIG_WATCHER_HPP
+
+#include <cstddef>  // size_t
+
+#include <condition_variable>  // std::condition_variable
+#include <functional>          // std::function
+#include <mutex>               // std::mutex
+#include <string>              // std::string
+#include <thread>              // std::thread
+
+namespace DBG {
+  // Polls a file on a background thread and passes its contents to a callback whenever it changes.
+  // A file which is missing or can not be read is skipped until it appears.
+  class configWatcher {
+  public:
+    configWatcher();
+    ~configWatcher();
+
+    configWatcher(const configWatcher &) = delete;
+    configWatcher &operator=(const configWatcher &) = delete;
+
+    // Replaces any previous watch. aCallback is called from the watcher thread, first with the current contents.
+    void watch(const std::string &aPath, size_t aMilliseconds, std::function<void(const std::string &)> aCallback);
+
+    // Stops the thread, a callback in progress is completed first
+    void stop();
+
+  private:
+    void watchThread(std::string aPath, size_t aMilliseconds, std::function<void(const std::string &)> aCallback);
+
+    bool mStop;
+    std::thread mWorker;
+    std::mutex mMutex;
+    std::condition_variable mCondition;
+  };
+}  // namespace DBG
+
+#endif
@@ -0,0 +1,128 @@
+/**
+* @Filename: DBG_decode.cpp
+* @Author:   Ben Sokol <Ben>
+* @Email:    ben@bensokol.com
+* @Created:  October 14th, 2026 [3:21pm]
+* @Modified: October 14th, 2026 [3:21pm]
+* @Version:  1.0.0
+*
+* Copyright (C) 2019 by Ben Sokol. All Rights Reserved.
+*/
+
+// Converts a binary log written with LOG_FORMAT::BINARY back into the text format.
+// Build as its own executable together with DBG_binaryLog.cpp.
+//
+//   DBG_decode [--from <unix seconds>] [--to <unix seconds>] [--verbosity <max>] <file>
+
+#include <cstdint>  // int64_t, uint8_t
+#include <ctime>    // time_t, strftime, localtime_r
+
+#include <chrono>    // std::chrono::system_clock
+#include <fstream>   // std::ifstream
+#include <iostream>  // std::cout, std::cerr
+#include <limits>    // std::numeric_limits
+#include <string>    // std::string, std::to_string
+
+#include "DBG_binaryLog.hpp"
+
+namespace {
+  void usage() {
+    std::cerr << "Usage: DBG_decode [--from <unix seconds>] [--to <unix seconds>] [--verbosity <max>] <file>\n";
+  }
+
+
+  // Same layout as DBG::out::appendTimestamp
+  std::string timestamp(int64_t aNanoseconds) {
+    std::chrono::system_clock::time_point time(
+      std::chrono::duration_cast<std::chrono::system_clock::duration>(std::chrono::nanoseconds(aNanoseconds)));
+    auto second = std::chrono::floor<std::chrono::seconds>(time);
+    time_t rawtime = std::chrono::system_clock::to_time_t(second);
+    struct tm timeinfo;
+    localtime_r(&rawtime, &timeinfo);
+    char buffer[80];
+    strftime(buffer, 80, "%h %d, %Y %H:%M:%S.", &timeinfo);
+    std::string microseconds = std::to_string(
+      std::chrono::duration_cast<std::chrono::microseconds>(time - second).count());
+    return buffer + std::string(6 - microseconds.size(), '0') + microseconds;
+  }
+}  // namespace
+
+
+int main(int argc, char **argv) {
+  int64_t from = std::numeric_limits<int64_t>::min();
+  int64_t to = std::numeric_limits<int64_t>::max();
+  int verbosity = std::numeric_limits<int>::max();
+  std::string filename;
+
+  try {
+    for (int i = 1; i < argc; ++i) {
+      std::string arg = argv[i];
+      if (arg == "--from" && i + 1 < argc) {
+        from = std::stoll(argv[++i]) * 1000000000LL;
+      }
+      else if (arg == "--to" && i + 1 < argc) {
+        to = std::stoll(argv[++i]) * 1000000000LL;
+      }
+      else if (arg == "--verbosity" && i + 1 < argc) {
+        verbosity = std::stoi(argv[++i]);
+      }
+      else if (filename.empty() && arg[0] != '-') {
+        filename = arg;
+      }
+      else {
+        usage();
+        return 1;
+      }
+    }
+  }
+  catch (const std::exception &) {
+    usage();
+    return 1;
+  }
+
+  if (filename.empty()) {
+    usage();
+    return 1;
+  }
+
+  std::ifstream input(filename, std::ifstream::binary);
+  if (!input.is_open()) {
+    std::cerr << "Unable to open " << filename << "\n";
+    return 1;
+  }
+
+  DBG::binaryReader reader(input);
+  if (!reader.valid()) {
+    std::cerr << filename << " is not a binary log\n";
+    return 1;
+  }
+
+  DBG::binaryLog::message message;
+  while (reader.next(message)) {
+    if (message.time < from || message.time > to || message.verbosity > verbosity) {
+      continue;
+    }
+
+    std::string line;
+
+    if (message.flags & DBG::binaryLog::TIMESTAMP) {
+      line += timestamp(message.time) + " - ";
+    }
+
+    if (message.flags & DBG::binaryLog::LOCATION) {
+      const DBG::binaryLog::site &site = reader.site(message.site);
+      line += site.file + ":" + site.function + ":" + std::to_string(site.line) + "\t - ";
+    }
+
+    line += message.body;
+
+    // Without it the text log would not have ended the line either
+    if (message.flags & DBG::binaryLog::NEWLINE) {
+      line += "\n";
+    }
+
+    std::cout << line;
+  }
+
+  return 0;
+}
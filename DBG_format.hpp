@@ -0,0 +1,322 @@
+/**
+* @Filename: DBG_format.hpp
+* @Author:   Ben Sokol <Ben>
+* @Email:    ben@bensokol.com
+* @Created:  October 14th, 2026 [3:10pm]
+* @Modified: October 14th, 2026 [3:10pm]
+* @Version:  1.0.0
+*
+* Copyright (C) 2019 by Ben Sokol. All Rights Reserved.
+*/
+
+#ifndef DBG_FORMAT_HPP
+#define DBG_FORMAT_HPP
+
+#include <cstddef>  // size_t, std::nullptr_t
+#include <cstring>  // memcpy, strlen
+
+#include <charconv>     // std::to_chars
+#include <new>          // std::launder
+#include <sstream>      // std::ostringstream
+#include <string>       // std::string
+#include <string_view>  // std::string_view
+#include <type_traits>  // std::decay_t, std::is_same_v, std::is_trivially_copyable_v
+#include <utility>      // std::declval, std::forward, std::move
+
+// Bytes stored inline in a pooled message
+#ifndef DBG_OUT_MESSAGE_SIZE
+  #define DBG_OUT_MESSAGE_SIZE 256
+#endif
+
+namespace DBG {
+  // Message body which is written in place, bodies longer than DBG_OUT_MESSAGE_SIZE move to the heap
+  class messageBuffer {
+  public:
+    messageBuffer() : mLength(0), mHeap(false) {
+    }
+
+    // Only the bytes in use are copied
+    messageBuffer(const messageBuffer &aOther) : mLength(aOther.mLength), mHeap(aOther.mHeap), mOverflow(aOther.mOverflow) {
+      if (!mHeap) {
+        std::memcpy(mBuffer, aOther.mBuffer, mLength);
+      }
+    }
+
+    messageBuffer(messageBuffer &&aOther) noexcept :
+        mLength(aOther.mLength),
+        mHeap(aOther.mHeap),
+        mOverflow(std::move(aOther.mOverflow)) {
+      if (!mHeap) {
+        std::memcpy(mBuffer, aOther.mBuffer, mLength);
+      }
+      aOther.clear();
+    }
+
+    messageBuffer &operator=(const messageBuffer &) = delete;
+    messageBuffer &operator=(messageBuffer &&) = delete;
+
+    void clear() {
+      mLength = 0;
+      mHeap = false;
+      mOverflow.clear();
+    }
+
+    // Returns space for aSize bytes at the end of the buffer, finish with commit()
+    char *reserve(size_t aSize) {
+      if (!mHeap && mLength + aSize <= DBG_OUT_MESSAGE_SIZE) {
+        return mBuffer + mLength;
+      }
+      if (!mHeap) {
+        mOverflow.assign(mBuffer, mLength);
+        mHeap = true;
+      }
+      mOverflow.resize(mLength + aSize);
+      return &mOverflow[mLength];
+    }
+
+    // Marks aSize bytes of the last reserve() as written
+    void commit(size_t aSize) {
+      mLength += aSize;
+      if (mHeap) {
+        mOverflow.resize(mLength);
+      }
+    }
+
+    void append(const char *aData, size_t aSize) {
+      std::memcpy(reserve(aSize), aData, aSize);
+      commit(aSize);
+    }
+
+    void append(std::string_view aStr) {
+      append(aStr.data(), aStr.size());
+    }
+
+    // An empty buffer takes over a string which would not fit inline instead of copying it
+    void append(std::string &&aStr) {
+      if (mLength == 0 && aStr.size() > DBG_OUT_MESSAGE_SIZE) {
+        mOverflow = std::move(aStr);
+        mLength = mOverflow.size();
+        mHeap = true;
+        return;
+      }
+      append(std::string_view(aStr));
+    }
+
+    void append(char aChar) {
+      *reserve(1) = aChar;
+      commit(1);
+    }
+
+    std::string_view view() const {
+      return mHeap ? std::string_view(mOverflow) : std::string_view(mBuffer, mLength);
+    }
+
+    size_t size() const {
+      return mLength;
+    }
+
+  private:
+    size_t mLength;
+    bool mHeap;
+    std::string mOverflow;
+    char mBuffer[DBG_OUT_MESSAGE_SIZE];
+  };
+
+
+  // Customization point, specialize with
+  //   static void format(messageBuffer &buffer, const T &value);
+  // Types without a specialization are written with operator<<
+  template <typename T, typename Enable = void>
+  struct formatter {};
+
+
+  namespace detail {
+    template <typename T, typename = void>
+    struct hasFormatter : std::false_type {};
+
+    template <typename T>
+    struct hasFormatter<T,
+                        std::void_t<decltype(formatter<T>::format(std::declval<messageBuffer &>(),
+                                                                  std::declval<const T &>()))>> :
+        std::true_type {};
+
+    template <typename T>
+    void toChars(messageBuffer &aBuffer, const T &aValue) {
+      // Large enough for any integer, or a floating point value in general format with precision 6
+      char buffer[64];
+      std::to_chars_result result;
+      if constexpr (std::is_floating_point_v<T>) {
+        // Matches the std::ostream default of %g with a precision of 6
+        result = std::to_chars(buffer, buffer + sizeof(buffer), aValue, std::chars_format::general, 6);
+      }
+      else {
+        result = std::to_chars(buffer, buffer + sizeof(buffer), aValue);
+      }
+      aBuffer.append(buffer, static_cast<size_t>(result.ptr - buffer));
+    }
+
+    template <typename T>
+    void streamValue(messageBuffer &aBuffer, const T &aValue) {
+      // Slow path, the stream is reused so that it is only constructed once per thread
+      static thread_local std::ostringstream tStream;
+      tStream.str(std::string());
+      tStream.clear();
+      tStream << aValue;
+#if __cplusplus > 201703L
+      aBuffer.append(tStream.view());
+#else
+      aBuffer.append(tStream.str());
+#endif
+    }
+  }  // namespace detail
+
+
+  // Appends a single value to aBuffer
+  template <typename T>
+  void formatValue(messageBuffer &aBuffer, const T &aValue) {
+    using type = std::decay_t<T>;
+
+    if constexpr (detail::hasFormatter<type>::value) {
+      formatter<type>::format(aBuffer, aValue);
+    }
+    else if constexpr (std::is_same_v<type, bool>) {
+      aBuffer.append(aValue ? '1' : '0');
+    }
+    else if constexpr (std::is_same_v<type, char> || std::is_same_v<type, signed char>
+                       || std::is_same_v<type, unsigned char>) {
+      aBuffer.append(static_cast<char>(aValue));
+    }
+    else if constexpr (std::is_integral_v<type> || std::is_floating_point_v<type>) {
+      detail::toChars(aBuffer, aValue);
+    }
+    else if constexpr (std::is_array_v<T> && std::is_same_v<std::remove_cv_t<std::remove_extent_t<T>>, char>) {
+      aBuffer.append(aValue, std::strlen(aValue));
+    }
+    else if constexpr (std::is_same_v<type, char *> || std::is_same_v<type, const char *>) {
+      if (aValue != nullptr) {
+        aBuffer.append(aValue, std::strlen(aValue));
+      }
+    }
+    // Converts to std::string_view, which would call strlen() on it
+    else if constexpr (std::is_same_v<type, std::nullptr_t>) {
+      aBuffer.append("nullptr", 7);
+    }
+    else if constexpr (std::is_convertible_v<const T &, std::string_view>) {
+      aBuffer.append(std::string_view(aValue));
+    }
+    else {
+      detail::streamValue(aBuffer, aValue);
+    }
+  }
+
+
+  // Strings passed as rvalues are moved into the buffer where possible
+  inline void formatValue(messageBuffer &aBuffer, std::string &&aValue) {
+    aBuffer.append(std::move(aValue));
+  }
+
+
+  // Appends every argument to aBuffer in order
+  template <typename... Args>
+  void format(messageBuffer &aBuffer, Args &&... args) {
+    (formatValue(aBuffer, std::forward<Args>(args)), ...);
+  }
+
+
+  // Deferred formatting: the producer stores raw argument bytes with encode() and the worker
+  // turns them into text with the decoder returned by decoderFor().
+  using decoder = void (*)(std::string_view aData, messageBuffer &aOutput);
+
+  namespace detail {
+    // std::nullptr_t converts to std::string_view as well, but can not be turned into one
+    template <typename T>
+    constexpr bool isString
+      = std::is_same_v<T, char *> || std::is_same_v<T, const char *>
+        || (std::is_convertible_v<const T &, std::string_view> && !std::is_same_v<T, std::nullptr_t>);
+
+    // Strings are copied, arithmetic values and trivially copyable types with a formatter are stored by value.
+    // nullptr is not stored at all.
+    template <typename T>
+    constexpr bool isDeferrable = std::is_arithmetic_v<T> || isString<T> || std::is_same_v<T, std::nullptr_t>
+                                  || (std::is_trivially_copyable_v<T> && hasFormatter<T>::value);
+
+    template <typename T>
+    void encodeValue(messageBuffer &aBuffer, const T &aValue) {
+      if constexpr (std::is_same_v<T, std::nullptr_t>) {
+        static_cast<void>(aBuffer);
+        static_cast<void>(aValue);
+      }
+      else if constexpr (isString<T>) {
+        std::string_view str;
+        if constexpr (std::is_pointer_v<T>) {
+          if (aValue != nullptr) {
+            str = aValue;
+          }
+        }
+        else {
+          str = aValue;
+        }
+        size_t size = str.size();
+        aBuffer.append(reinterpret_cast<const char *>(&size), sizeof(size));
+        aBuffer.append(str);
+      }
+      else {
+        aBuffer.append(reinterpret_cast<const char *>(&aValue), sizeof(T));
+      }
+    }
+
+    template <typename T>
+    void decodeValue(const char *&aCursor, messageBuffer &aOutput) {
+      if constexpr (std::is_same_v<T, std::nullptr_t>) {
+        static_cast<void>(aCursor);
+        formatValue(aOutput, nullptr);
+      }
+      else if constexpr (isString<T>) {
+        size_t size;
+        std::memcpy(&size, aCursor, sizeof(size));
+        aCursor += sizeof(size);
+        aOutput.append(aCursor, size);
+        aCursor += size;
+      }
+      else {
+        alignas(T) unsigned char storage[sizeof(T)];
+        std::memcpy(storage, aCursor, sizeof(T));
+        aCursor += sizeof(T);
+        formatValue(aOutput, *std::launder(reinterpret_cast<const T *>(storage)));
+      }
+    }
+
+    template <typename... Args>
+    void decode(std::string_view aData, messageBuffer &aOutput) {
+      const char *cursor = aData.data();
+      (decodeValue<Args>(cursor, aOutput), ...);
+    }
+  }  // namespace detail
+
+
+  // True if every argument can be captured without formatting
+  template <typename... Args>
+  constexpr bool deferrable = (detail::isDeferrable<std::decay_t<Args>> && ...);
+
+
+  // True if any argument is a std::string rvalue, which format() moves but encode() would copy
+  template <typename... Args>
+  constexpr bool movesString = (std::is_same_v<Args, std::string> || ...);
+
+
+  // Stores the raw bytes of every argument in aBuffer
+  template <typename... Args>
+  void encode(messageBuffer &aBuffer, Args &&... args) {
+    static_assert(deferrable<Args...>, "Argument can not be captured for deferred formatting");
+    (detail::encodeValue<std::decay_t<Args>>(aBuffer, args), ...);
+  }
+
+
+  // Returns the function which formats the output of encode() for the same argument types
+  template <typename... Args>
+  constexpr decoder decoderFor() {
+    return &detail::decode<std::decay_t<Args>...>;
+  }
+}  // namespace DBG
+
+#endif
@@ -0,0 +1,162 @@
+/**
+* @Filename: DBG_mappedFile.cpp
+* @Author:   Ben Sokol <Ben>
+* @Email:    ben@bensokol.com
+* @Created:  October 14th, 2026 [3:15pm]
+* @Modified: October 14th, 2026 [3:15pm]
+* @Version:  1.0.0
+*
+* Copyright (C) 2019 by Ben Sokol. All Rights Reserved.
+*/
+
+#include <cstddef>  // size_t
+#include <cstring>  // memcpy
+
+#include <algorithm>  // std::min
+#include <string>     // std::string
+
+#include "DBG_mappedFile.hpp"
+
+#if __has_include(<sys/mman.h>)
+  #include <fcntl.h>     // open
+  #include <sys/mman.h>  // mmap, munmap, msync
+  #include <sys/stat.h>  // fstat
+  #include <unistd.h>    // ftruncate, close
+  #define DBG_OUT_HAS_MMAP
+#endif
+
+namespace DBG {
+  mappedFile::mappedFile() : mFD(-1), mData(nullptr), mMapped(0), mOffset(0), mChunkSize(0), mStep(0) {
+  }
+
+
+  mappedFile::~mappedFile() {
+    close();
+  }
+
+
+  bool mappedFile::open(const std::string &aPath, size_t aChunkSize) {
+    close();
+
+#ifdef DBG_OUT_HAS_MMAP
+    mFD = ::open(aPath.c_str(), O_RDWR | O_CREAT, 0644);
+    if (mFD < 0) {
+      return false;
+    }
+
+    struct stat info;
+    if (fstat(mFD, &info) != 0) {
+      close();
+      return false;
+    }
+
+    mChunkSize = aChunkSize;
+    mStep = std::min<size_t>(DBG_OUT_MMAP_MIN_CHUNK_SIZE, mChunkSize);
+    mOffset = static_cast<size_t>(info.st_size);
+    if (!map(mOffset + mStep)) {
+      close();
+      return false;
+    }
+
+    return true;
+#else
+    (void)aPath;
+    (void)aChunkSize;
+    return false;
+#endif
+  }
+
+
+  bool mappedFile::isOpen() const {
+    return mData != nullptr;
+  }
+
+
+  bool mappedFile::write(const char *aData, size_t aSize) {
+    if (mData == nullptr) {
+      return false;
+    }
+
+    if (mOffset + aSize > mMapped) {
+      // Small steps first, so short logs do not leave a whole chunk of zeros behind after a crash
+      mStep = std::min(mStep * 2, mChunkSize);
+      size_t size = mMapped + mStep;
+      while (mOffset + aSize > size) {
+        size += mStep;
+      }
+      if (!map(size)) {
+        close();
+        return false;
+      }
+    }
+
+    std::memcpy(mData + mOffset, aData, aSize);
+    mOffset += aSize;
+    return true;
+  }
+
+
+  void mappedFile::flush() {
+#ifdef DBG_OUT_HAS_MMAP
+    if (mData != nullptr) {
+      msync(mData, mMapped, MS_ASYNC);
+    }
+#endif
+  }
+
+
+  void mappedFile::close() {
+#ifdef DBG_OUT_HAS_MMAP
+    unmap();
+
+    if (mFD >= 0) {
+      // Drop the preallocated space which was never written
+      if (ftruncate(mFD, static_cast<off_t>(mOffset)) != 0) {
+        // Nothing can be done here, the file keeps trailing zeros
+      }
+      ::close(mFD);
+      mFD = -1;
+    }
+#endif
+    mOffset = 0;
+  }
+
+
+  size_t mappedFile::size() const {
+    return mOffset;
+  }
+
+
+  bool mappedFile::map(size_t aSize) {
+#ifdef DBG_OUT_HAS_MMAP
+    unmap();
+
+    if (ftruncate(mFD, static_cast<off_t>(aSize)) != 0) {
+      return false;
+    }
+
+    void *data = mmap(nullptr, aSize, PROT_READ | PROT_WRITE, MAP_SHARED, mFD, 0);
+    if (data == MAP_FAILED) {
+      return false;
+    }
+
+    mData = static_cast<char *>(data);
+    mMapped = aSize;
+    return true;
+#else
+    (void)aSize;
+    return false;
+#endif
+  }
+
+
+  void mappedFile::unmap() {
+#ifdef DBG_OUT_HAS_MMAP
+    if (mData != nullptr) {
+      munmap(mData, mMapped);
+      mData = nullptr;
+      mMapped = 0;
+    }
+#endif
+  }
+}  // namespace DBG
@@ -0,0 +1,71 @@
+/**
+* @Filename: DBG_mappedFile.hpp
+* @Author:   Ben Sokol <Ben>
+* @Email:    ben@bensokol.com
+* @Created:  October 14th, 2026 [3:15pm]
+* @Modified: October 14th, 2026 [3:15pm]
+* @Version:  1.0.0
+*
+* Copyright (C) 2019 by Ben Sokol. All Rights Reserved.
+*/
+
+#ifndef DBG_MAPPED_FILE_HPP
+#define DBG_MAPPED_FILE_HPP
+
+#include <cstddef>  // size_t
+
+#include <string>  // std::string
+
+// Bytes the file is grown by whenever the mapping is full. Growth starts at DBG_OUT_MMAP_MIN_CHUNK_SIZE
+// and doubles with every remap up to DBG_OUT_MMAP_CHUNK_SIZE.
+#ifndef DBG_OUT_MMAP_CHUNK_SIZE
+  #define DBG_OUT_MMAP_CHUNK_SIZE (64 * 1024 * 1024)
+#endif
+
+#ifndef DBG_OUT_MMAP_MIN_CHUNK_SIZE
+  #define DBG_OUT_MMAP_MIN_CHUNK_SIZE (1024 * 1024)
+#endif
+
+namespace DBG {
+  // Log file written through a shared memory mapping.
+  // The file is preallocated in chunks and writes are a memcpy into the mapping, so data that has been
+  // written survives a crash of the process. The unused tail of the last chunk is removed on close().
+  // After a crash it stays: the file ends in up to one chunk of zero bytes. Text readers see NUL characters
+  // after the last line, DBG_decode stops at the first of them.
+  class mappedFile {
+  public:
+    mappedFile();
+    ~mappedFile();
+
+    mappedFile(const mappedFile &) = delete;
+    mappedFile &operator=(const mappedFile &) = delete;
+
+    // Appends to aPath, creating it if needed. Returns false if mmap is unavailable or the file can not be opened.
+    bool open(const std::string &aPath, size_t aChunkSize = DBG_OUT_MMAP_CHUNK_SIZE);
+    bool isOpen() const;
+
+    // Returns false if the file could not be grown, the file is closed then and aData is not written
+    bool write(const char *aData, size_t aSize);
+
+    // Schedules written pages to be written back to disk
+    void flush();
+
+    void close();
+
+    // Bytes written to the file
+    size_t size() const;
+
+  private:
+    bool map(size_t aSize);
+    void unmap();
+
+    int mFD;
+    char *mData;
+    size_t mMapped;
+    size_t mOffset;
+    size_t mChunkSize;  // Largest growth step
+    size_t mStep;       // Next growth step
+  };
+}  // namespace DBG
+
+#endif
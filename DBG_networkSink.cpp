@@ -0,0 +1,387 @@
+/**
+* @Filename: DBG_networkSink.cpp
+* @Author:   Ben Sokol <Ben>
+* @Email:    ben@bensokol.com
+* @Created:  October 14th, 2026 [4:20pm]
+* @Modified: October 14th, 2026 [4:20pm]
+* @Version:  1.0.0
+*
+* Copyright (C) 2019 by Ben Sokol. All Rights Reserved.
+*/
+
+#include <cerrno>   // errno, EINTR
+#include <cstddef>  // size_t
+#include <cstdint>  // uint8_t, uint16_t, uint64_t
+#include <cstring>  // memcpy
+
+#include <algorithm>    // std::min
+#include <chrono>       // std::chrono::milliseconds
+#include <mutex>        // std::mutex, std::unique_lock
+#include <string>       // std::string, std::to_string
+#include <string_view>  // std::string_view
+#include <utility>      // std::move
+
+#include "DBG_networkSink.hpp"
+
+#if __has_include(<sys/socket.h>) && __has_include(<netdb.h>) && __has_include(<unistd.h>)
+  #include <netdb.h>       // getaddrinfo, freeaddrinfo
+  #include <sys/socket.h>  // socket, connect, send, setsockopt
+  #include <sys/time.h>    // timeval
+  #include <sys/types.h>   // ssize_t
+  #include <unistd.h>      // close
+  #define DBG_OUT_HAS_SOCKETS
+#endif
+
+#ifndef MSG_NOSIGNAL
+  #define MSG_NOSIGNAL 0
+#endif
+
+// Connecting and sending give up after this long, so a stalled collector looks like a lost connection
+#ifndef DBG_OUT_NETWORK_TIMEOUT_MS
+  #define DBG_OUT_NETWORK_TIMEOUT_MS 5000
+#endif
+
+// TCP batches are sent in packets of up to this many bytes
+#define DBG_OUT_NETWORK_PACKET_SIZE (64 * 1024)
+
+namespace DBG {
+  namespace {
+    // Layout of a buffered record, followed by size bytes of text
+    struct recordHeader {
+      const callSite *site;  // nullptr for raw output
+      std::chrono::system_clock::time_point time;
+      uint64_t thread;
+      size_t size;
+      uint8_t verbosity;
+      uint8_t flags;
+    };
+
+    // Text bytes of the buffered records starting at aPos
+    size_t textSize(const std::string &aRecords, size_t aPos) {
+      size_t size = 0;
+      recordHeader header;
+      for (; aPos < aRecords.size(); aPos += sizeof(header) + header.size) {
+        std::memcpy(&header, aRecords.data() + aPos, sizeof(header));
+        size += header.size;
+      }
+      return size;
+    }
+  }  // namespace
+
+
+  networkSink::networkSink(const std::string &aHost,
+                           uint16_t aPort,
+                           PROTOCOL aProtocol,
+                           FORMAT aFormat,
+                           size_t aCapacity) :
+      mHost(aHost),
+      mPort(aPort),
+      mProtocol(aProtocol),
+      mFormat(aFormat),
+      mCapacity(aCapacity),
+      mSocket(-1),
+      mPacketText(0),
+      mPacketRecords(0),
+      mStop(false),
+      mSending(false),
+      mConnected(false),
+      mDropped(0) {
+    mWorker = std::thread(&networkSink::sendThread, this);
+  }
+
+
+  networkSink::~networkSink() {
+    {
+      std::unique_lock<std::mutex> lock(mMutex);
+      mStop = true;
+    }
+    mBufferCondition.notify_one();
+    if (mWorker.joinable()) {
+      mWorker.join();
+    }
+  }
+
+
+  void networkSink::write(const char *aData, size_t aSize) {
+    if (mFormat == FORMAT::BINARY) {
+      return;
+    }
+    sinkRecord record{nullptr, std::chrono::system_clock::time_point(), 0, 0, 0, std::string_view(), std::string_view()};
+    if (buffer(nullptr, record, std::string_view(aData, aSize))) {
+      mBufferCondition.notify_one();
+    }
+  }
+
+
+  void networkSink::flush() {
+    // Batches are sent as soon as the previous one is done, there is nothing to hold back
+  }
+
+
+  bool networkSink::wantsRecords() const {
+    return true;
+  }
+
+
+  void networkSink::writeRecord(const sinkRecord &aRecord) {
+    if (buffer(aRecord.site, aRecord, mFormat == FORMAT::BINARY ? aRecord.body : aRecord.line)) {
+      mBufferCondition.notify_one();
+    }
+  }
+
+
+  void networkSink::wait() {
+    std::unique_lock<std::mutex> lock(mMutex);
+    mIdleCondition.wait(lock, [this]() {
+      return (mBuffer.empty() && !mSending) || !mConnected;
+    });
+  }
+
+
+  bool networkSink::connected() const {
+    return mConnected;
+  }
+
+
+  size_t networkSink::dropped() const {
+    return mDropped;
+  }
+
+
+  bool networkSink::buffer(const callSite *aSite, const sinkRecord &aRecord, std::string_view aText) {
+    recordHeader header{aSite,
+                        aRecord.time,
+                        aRecord.thread,
+                        aText.size(),
+                        static_cast<uint8_t>(std::min<size_t>(aRecord.verbosity, UINT8_MAX)),
+                        aRecord.flags};
+    size_t size = sizeof(header) + aText.size();
+    // Each verbosity level halves the part of the buffer it may use
+    size_t limit = mCapacity >> std::min<size_t>(aRecord.verbosity, sizeof(size_t) * 8 - 1);
+
+    std::unique_lock<std::mutex> lock(mMutex);
+    if (mBuffer.size() + size > limit) {
+      mDropped += aText.size();
+      return false;
+    }
+    mBuffer.append(reinterpret_cast<const char *>(&header), sizeof(header));
+    mBuffer.append(aText);
+    return true;
+  }
+
+
+  void networkSink::sendThread() {
+    std::string sending;
+    auto backoff = std::chrono::milliseconds(DBG_OUT_NETWORK_BACKOFF_MIN_MS);
+
+    for (;;) {
+      if (mSocket < 0 && !connect()) {
+        std::unique_lock<std::mutex> lock(mMutex);
+        mIdleCondition.notify_all();
+        // Nothing can be sent when stopping without a connection
+        if (mStop) {
+          mDropped += textSize(mBuffer, 0);
+          mBuffer.clear();
+          break;
+        }
+        mBufferCondition.wait_for(lock, backoff, [this]() {
+          return mStop;
+        });
+        backoff = std::min(backoff * 2, std::chrono::milliseconds(DBG_OUT_NETWORK_BACKOFF_MAX_MS));
+        continue;
+      }
+      backoff = std::chrono::milliseconds(DBG_OUT_NETWORK_BACKOFF_MIN_MS);
+
+      {
+        std::unique_lock<std::mutex> lock(mMutex);
+        mSending = false;
+        mIdleCondition.notify_all();
+
+        mBufferCondition.wait(lock, [this]() {
+          return mStop || !mBuffer.empty();
+        });
+
+        // Whatever is buffered is still sent when stopping
+        if (mStop && mBuffer.empty()) {
+          break;
+        }
+
+        sending.swap(mBuffer);
+        mSending = true;
+      }
+
+      if (!send(sending)) {
+        disconnect();
+      }
+      sending.clear();
+    }
+
+    disconnect();
+    std::unique_lock<std::mutex> lock(mMutex);
+    mSending = false;
+    mIdleCondition.notify_all();
+  }
+
+
+  bool networkSink::connect() {
+#ifdef DBG_OUT_HAS_SOCKETS
+    struct addrinfo hints = {};
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = mProtocol == PROTOCOL::TCP ? SOCK_STREAM : SOCK_DGRAM;
+
+    struct addrinfo *addresses = nullptr;
+    if (getaddrinfo(mHost.c_str(), std::to_string(mPort).c_str(), &hints, &addresses) != 0) {
+      return false;
+    }
+
+    struct timeval timeout;
+    timeout.tv_sec = DBG_OUT_NETWORK_TIMEOUT_MS / 1000;
+    timeout.tv_usec = (DBG_OUT_NETWORK_TIMEOUT_MS % 1000) * 1000;
+
+    for (struct addrinfo *address = addresses; address != nullptr && mSocket < 0; address = address->ai_next) {
+      int fd = socket(address->ai_family, address->ai_socktype, address->ai_protocol);
+      if (fd < 0) {
+        continue;
+      }
+      // Also bounds connect() on Linux
+      setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+  #ifdef SO_NOSIGPIPE
+      int on = 1;
+      setsockopt(fd, SOL_SOCKET, SO_NOSIGPIPE, &on, sizeof(on));
+  #endif
+      if (::connect(fd, address->ai_addr, address->ai_addrlen) == 0) {
+        mSocket = fd;
+      }
+      else {
+        ::close(fd);
+      }
+    }
+    freeaddrinfo(addresses);
+
+    if (mSocket < 0) {
+      return false;
+    }
+
+    // The collector sees a new stream, so sites have to be sent again
+    mPacket.clear();
+    mPacketText = 0;
+    mPacketRecords = 0;
+    if (mFormat == FORMAT::BINARY && mProtocol == PROTOCOL::TCP) {
+      mWriter.begin(mPacket);
+    }
+    mConnected = true;
+    return true;
+#else
+    return false;
+#endif
+  }
+
+
+  void networkSink::disconnect() {
+#ifdef DBG_OUT_HAS_SOCKETS
+    if (mSocket >= 0) {
+      ::close(mSocket);
+      mSocket = -1;
+    }
+#endif
+    mConnected = false;
+  }
+
+
+  bool networkSink::send(const std::string &aRecords) {
+    bool tcp = mProtocol == PROTOCOL::TCP;
+    size_t packetSize = tcp ? DBG_OUT_NETWORK_PACKET_SIZE : DBG_OUT_NETWORK_DATAGRAM_SIZE;
+    std::string_view text;
+    recordHeader header;
+
+    for (size_t pos = 0; pos < aRecords.size(); pos += sizeof(header) + header.size) {
+      std::memcpy(&header, aRecords.data() + pos, sizeof(header));
+      text = std::string_view(aRecords.data() + pos + sizeof(header), header.size);
+
+      // A datagram without records is never sent, the start of the packet is kept for the first one
+      bool first = mPacketRecords == 0;
+      size_t start = mPacket.size();
+      if (!tcp && mPacket.empty() && mFormat == FORMAT::BINARY) {
+        mWriter.begin(mPacket);
+      }
+      if (mFormat == FORMAT::BINARY) {
+        mWriter.append(mPacket, *header.site, header.time, header.thread, header.verbosity, header.flags, text);
+      }
+      else {
+        mPacket += text;
+      }
+      mPacketText += header.size;
+      ++mPacketRecords;
+
+      if (tcp) {
+        if (mPacket.size() >= packetSize && !sendPacket(mPacket)) {
+          mDropped += textSize(aRecords, pos + sizeof(header) + header.size);
+          return false;
+        }
+        continue;
+      }
+
+      if (mPacket.size() <= packetSize) {
+        continue;
+      }
+
+      // Datagrams end on a record boundary, the earlier records are sent and this one starts the next datagram
+      if (!first) {
+        std::string record = mPacket.substr(start);
+        mPacket.resize(start);
+        mPacketText -= header.size;
+        --mPacketRecords;
+        if (!sendPacket(mPacket)) {
+          mDropped += textSize(aRecords, pos);
+          return false;
+        }
+        if (mFormat == FORMAT::BINARY) {
+          mWriter.begin(mPacket);
+          mWriter.append(mPacket, *header.site, header.time, header.thread, header.verbosity, header.flags, text);
+        }
+        else {
+          mPacket = std::move(record);
+        }
+        mPacketText = header.size;
+        mPacketRecords = 1;
+      }
+
+      // A single record which does not fit a datagram can not be sent
+      if (mPacket.size() > packetSize) {
+        mDropped += header.size;
+        mPacket.clear();
+        mPacketText = 0;
+        mPacketRecords = 0;
+      }
+    }
+
+    return mPacketRecords == 0 || sendPacket(mPacket);
+  }
+
+
+  bool networkSink::sendPacket(const std::string &aPacket) {
+    // Only the text of the records counts as dropped, not the packet's headers and sites
+    bool sent = false;
+#ifdef DBG_OUT_HAS_SOCKETS
+    size_t done = 0;
+    while (done < aPacket.size()) {
+      ssize_t result = ::send(mSocket, aPacket.data() + done, aPacket.size() - done, MSG_NOSIGNAL);
+      if (result < 0 && errno == EINTR) {
+        continue;
+      }
+      if (result <= 0) {
+        break;
+      }
+      done += static_cast<size_t>(result);
+    }
+    sent = done == aPacket.size();
+#endif
+    if (!sent) {
+      mDropped += mPacketText;
+    }
+    mPacket.clear();
+    mPacketText = 0;
+    mPacketRecords = 0;
+    return sent;
+  }
+}  // namespace DBG
@@ -0,0 +1,122 @@
+/**
+* @Filename: DBG_networkSink.hpp
+* @Author:   Ben Sokol <Ben>
+* @Email:    ben@bensokol.com
+* @Created:  October 14th, 2026 [4:20pm]
+* @Modified: October 14th, 2026 [4:20pm]
+* @Version:  1.0.0
+*
+* Copyright (C) 2019 by Ben Sokol. All Rights Reserved.
+*/
+
+#ifndef DBG_NETWORK_SINK_HPP
+#define DBG_NETWORK_SINK_HPP
+
+#include <cstddef>  // size_t
+#include <cstdint>  // uint16_t
+
+#include <atomic>              // std::atomic
+#include <condition_variable>  // std::condition_variable
+#include <mutex>               // std::mutex
+#include <string>              // std::string
+#include <thread>              // std::thread
+
+#include "DBG_binaryLog.hpp"
+#include "DBG_sink.hpp"
+
+// Bytes a networkSink buffers while it is sending or disconnected
+#ifndef DBG_OUT_NETWORK_BUFFER_SIZE
+  #define DBG_OUT_NETWORK_BUFFER_SIZE (4 * 1024 * 1024)
+#endif
+
+// Largest UDP payload, the default fits an Ethernet frame
+#ifndef DBG_OUT_NETWORK_DATAGRAM_SIZE
+  #define DBG_OUT_NETWORK_DATAGRAM_SIZE 1472
+#endif
+
+// Reconnect delay, doubled after every failed attempt up to the maximum
+#ifndef DBG_OUT_NETWORK_BACKOFF_MIN_MS
+  #define DBG_OUT_NETWORK_BACKOFF_MIN_MS 100
+#endif
+
+#ifndef DBG_OUT_NETWORK_BACKOFF_MAX_MS
+  #define DBG_OUT_NETWORK_BACKOFF_MAX_MS 30000
+#endif
+
+namespace DBG {
+  // Ships messages to a collector over TCP or UDP from its own thread, so the worker never waits for the network.
+  // Messages are buffered while a batch is being sent or the collector is unreachable. Under pressure a message
+  // of verbosity v may only fill the buffer up to DBG_OUT_NETWORK_BUFFER_SIZE >> v bytes, so verbose output
+  // is dropped first and verbosity 0 is only dropped when the buffer is full.
+  // The buffer grows on demand, with a batch being sent the sink holds up to 2 * aCapacity bytes.
+  //
+  // BINARY uses the binary log format. Every TCP connection and every UDP datagram starts with its own header
+  // and site records, so the collector can decode each of them on its own.
+  class networkSink : public sink {
+  public:
+    enum class PROTOCOL { TCP, UDP };
+    enum class FORMAT { TEXT, BINARY };
+
+    networkSink(const std::string &aHost,
+                uint16_t aPort,
+                PROTOCOL aProtocol = PROTOCOL::TCP,
+                FORMAT aFormat = FORMAT::TEXT,
+                size_t aCapacity = DBG_OUT_NETWORK_BUFFER_SIZE);
+    ~networkSink() override;
+
+    // Raw output such as the trace header, sent as verbosity 0. Ignored in the BINARY format.
+    void write(const char *aData, size_t aSize) override;
+    void flush() override;
+
+    bool wantsRecords() const override;
+    void writeRecord(const sinkRecord &aRecord) override;
+
+    // Blocks until everything buffered has been sent or dropped
+    void wait();
+
+    // True while a connection is established
+    bool connected() const;
+
+    // Text bytes of the messages dropped because the buffer was full, a send failed or a record did not fit a
+    // datagram. Headers and sites of the binary format are not counted.
+    size_t dropped() const override;
+
+  private:
+    // Appends a record to mBuffer in the internal layout, returns false if it is dropped
+    bool buffer(const callSite *aSite, const sinkRecord &aRecord, std::string_view aText);
+
+    void sendThread();
+
+    // Returns false if the connection attempt failed
+    bool connect();
+    void disconnect();
+
+    // Encodes the records in aRecords and sends them, returns false if the connection failed
+    bool send(const std::string &aRecords);
+    bool sendPacket(const std::string &aPacket);
+
+    const std::string mHost;
+    const uint16_t mPort;
+    const PROTOCOL mProtocol;
+    const FORMAT mFormat;
+    const size_t mCapacity;
+
+    int mSocket;  // Only used by the send thread
+    binaryWriter mWriter;
+    std::string mPacket;
+    size_t mPacketText;     // Text bytes of the records in mPacket
+    size_t mPacketRecords;  // Records in mPacket, a packet without any is not sent
+
+    bool mStop;
+    bool mSending;
+    std::string mBuffer;
+    std::atomic<bool> mConnected;
+    std::atomic<size_t> mDropped;
+    std::thread mWorker;
+    std::mutex mMutex;
+    std::condition_variable mBufferCondition;
+    std::condition_variable mIdleCondition;
+  };
+}  // namespace DBG
+
+#endif
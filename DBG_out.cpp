@@ -9,22 +9,35 @@
 * Copyright (C) 2019 by Ben Sokol. All Rights Reserved.
 */
 
-#include <cstdint>  // uint8_t
-#include <ctime>    // time_t, strftime
-
+#include <csignal>  // std::signal, std::raise
+#include <cstdint>  // uint8_t, uint64_t, int64_t
+#include <cstdlib>  // std::abort, std::getenv
+#include <cstring>  // memcpy
+#include <ctime>    // time_t, strftime, localtime_r
+
+#include <algorithm>           // std::min, std::stable_sort
+#include <atomic>              // std::atomic
+#include <charconv>            // std::from_chars, std::to_chars
 #include <chrono>              // std::chrono::system_clock
 #include <condition_variable>  // std::condition_variable
+#include <exception>           // std::set_terminate
 #include <fstream>             // std::ofstream
 #include <iostream>            // std::cerr
+#include <iterator>            // std::istreambuf_iterator
+#include <map>                 // std::map
+#include <memory>              // std::shared_ptr
 #include <mutex>               // std::mutex, std::unique_lock
 #include <queue>               // std::queue
 #include <string>              // std::string
+#include <string_view>         // std::string_view
+#include <system_error>        // std::error_code
 #include <thread>              // std::thread
+#include <utility>             // std::move, std::pair
+#include <vector>              // std::vector
 
+#include "DBG_clock.hpp"
 #include "DBG_out.hpp"
 
-#include "UTL_timeType.hpp"
-
 #if __has_include(<filesystem>)
   #include <filesystem>
   #ifndef std_filesystem
@@ -39,120 +52,496 @@
   #error Requires std::filesystem or std::experimental::filesystem
 #endif
 
+#if __has_include(<unistd.h>)
+  #include <unistd.h>  // getpid
+  #define DBG_OUT_HAS_GETPID
+#endif
+
 namespace DBG {
-  out::container::container(const std::string &_str,
-                            const bool &_printTimestamp,
-                            const bool &_printLocation,
-                            const bool &_os,
-                            const bool &_ofs,
-                            const int &_line,
-                            const std::string &_file,
-                            const std::string &_function,
-                            const size_t &_verbosity) :
-      str(_str),
-      printTimestamp(_printTimestamp),
-      printLocation(_printLocation),
-      os(_os),
-      ofs(_ofs),
-      time(std::chrono::system_clock::now()),
-      line(_line),
-      file(_file),
-      function(_function),
-      verbosity(_verbosity) {
+  namespace {
+    // Small sequential id of the calling thread
+    uint64_t threadID() {
+      static std::atomic<uint64_t> next(1);
+      static thread_local uint64_t id = next.fetch_add(1, std::memory_order_relaxed);
+      return id;
+    }
+
+    // Signals handled by out::flushOnCrash()
+    const int CRASH_SIGNALS[] = {SIGSEGV,
+                                 SIGFPE,
+                                 SIGILL,
+                                 SIGABRT,
+#ifdef SIGBUS
+                                 SIGBUS
+#endif
+    };
+    constexpr size_t CRASH_SIGNAL_COUNT = sizeof(CRASH_SIGNALS) / sizeof(CRASH_SIGNALS[0]);
+
+    // Handlers replaced by out::flushOnCrash(), guarded by crashHandlerMutex
+    std::mutex crashHandlerMutex;
+    bool crashHandlersInstalled = false;
+    void (*previousSignalHandlers[CRASH_SIGNAL_COUNT])(int);
+    std::terminate_handler previousTerminateHandler = nullptr;
+
+    // Loggers flushed by the crash handlers. Slots are written under crashHandlerMutex, the handlers only read them.
+    constexpr size_t CRASH_LOGGER_COUNT = 16;
+    std::atomic<out *> crashLoggers[CRASH_LOGGER_COUNT];
+
+    // Loggers created by out::instance(name)
+    std::mutex loggersMutex;
+
+    // Body of a DBG_scope record: name, start and end ticks, thread
+    struct scopeRecord {
+      std::string_view name;
+      uint64_t start;
+      uint64_t end;
+      uint64_t thread;
+    };
+
+    scopeRecord readScope(std::string_view aData) {
+      scopeRecord record;
+      const char *cursor = aData.data();
+      size_t size;
+      std::memcpy(&size, cursor, sizeof(size));
+      cursor += sizeof(size);
+      record.name = std::string_view(cursor, size);
+      cursor += size;
+      std::memcpy(&record.start, cursor, sizeof(record.start));
+      cursor += sizeof(record.start);
+      std::memcpy(&record.end, cursor, sizeof(record.end));
+      cursor += sizeof(record.end);
+      std::memcpy(&record.thread, cursor, sizeof(record.thread));
+      return record;
+    }
+
+    // "<name> took <n> us"
+    void decodeScope(std::string_view aData, messageBuffer &aOutput) {
+      scopeRecord record = readScope(aData);
+      format(aOutput, record.name, " took ", tscClock::nanoseconds(record.end - record.start) / 1000.0, " us");
+    }
+
+    // Complete event of the Chrome trace event format, times in microseconds
+    void decodeTrace(std::string_view aData, messageBuffer &aOutput) {
+      scopeRecord record = readScope(aData);
+      int64_t ts = std::chrono::duration_cast<std::chrono::microseconds>(
+                     tscClock::toSystem(record.start).time_since_epoch())
+                     .count();
+#ifdef DBG_OUT_HAS_GETPID
+      int64_t pid = getpid();
+#else
+      int64_t pid = 0;
+#endif
+      format(aOutput,
+             "{\"name\":\"",
+             record.name,
+             "\",\"ph\":\"X\",\"ts\":",
+             ts,
+             ",\"dur\":",
+             tscClock::nanoseconds(record.end - record.start) / 1000.0,
+             ",\"pid\":",
+             pid,
+             ",\"tid\":",
+             record.thread,
+             "},");
+    }
+
+    bool parseBool(std::string_view aValue, bool &_value) {
+      if (aValue == "1" || aValue == "true" || aValue == "on") {
+        _value = true;
+        return true;
+      }
+      if (aValue == "0" || aValue == "false" || aValue == "off") {
+        _value = false;
+        return true;
+      }
+      return false;
+    }
+
+    bool parseSize(std::string_view aValue, size_t &_value) {
+      auto result = std::from_chars(aValue.data(), aValue.data() + aValue.size(), _value);
+      return result.ec == std::errc() && result.ptr == aValue.data() + aValue.size();
+    }
+
+    bool parseSetting(std::string_view aKey, std::string_view aValue, out::settings &_settings) {
+      if (aKey == "enable") {
+        return parseBool(aValue, _settings.enabled);
+      }
+      if (aKey == "os") {
+        return parseBool(aValue, _settings.os);
+      }
+      if (aKey == "ofs") {
+        return parseBool(aValue, _settings.ofs);
+      }
+      if (aKey == "timestamp") {
+        return parseBool(aValue, _settings.timestamp);
+      }
+      if (aKey == "location") {
+        return parseBool(aValue, _settings.location);
+      }
+      if (aKey == "newline") {
+        return parseBool(aValue, _settings.newline);
+      }
+      if (aKey == "deferred") {
+        return parseBool(aValue, _settings.deferred);
+      }
+      if (aKey == "verbosity") {
+        size_t verbosity;
+        if (!parseSize(aValue, verbosity) || verbosity > UINT8_MAX) {
+          return false;
+        }
+        _settings.verbosity = static_cast<uint8_t>(verbosity);
+        return true;
+      }
+      if (aKey == "flush") {
+        const std::pair<std::string_view, out::FLUSH_POLICY> policies[] = {{"always", out::FLUSH_POLICY::ALWAYS},
+                                                                           {"manual", out::FLUSH_POLICY::MANUAL},
+                                                                           {"messages", out::FLUSH_POLICY::MESSAGES},
+                                                                           {"bytes", out::FLUSH_POLICY::BYTES},
+                                                                           {"interval", out::FLUSH_POLICY::INTERVAL}};
+        for (auto &policy : policies) {
+          if (aValue == policy.first) {
+            _settings.flushPolicy = policy.second;
+            return true;
+          }
+        }
+        return false;
+      }
+      if (aKey == "flush_threshold") {
+        return parseSize(aValue, _settings.flushThreshold);
+      }
+      if (aKey == "rotate_size") {
+        return parseSize(aValue, _settings.rotateSize);
+      }
+      if (aKey == "rotate_interval") {
+        return parseSize(aValue, _settings.rotateInterval);
+      }
+      if (aKey == "format") {
+        if (aValue == "text" || aValue == "binary") {
+          _settings.logFormat = aValue == "text" ? out::LOG_FORMAT::TEXT : out::LOG_FORMAT::BINARY;
+          return true;
+        }
+        return false;
+      }
+      if (aKey == "file_mode") {
+        const std::pair<std::string_view, out::FILE_MODE> modes[] = {{"stream", out::FILE_MODE::STREAM},
+                                                                     {"mmap", out::FILE_MODE::MMAP},
+                                                                     {"aio", out::FILE_MODE::AIO}};
+        for (auto &mode : modes) {
+          if (aValue == mode.first) {
+            _settings.fileMode = mode.second;
+            return true;
+          }
+        }
+        return false;
+      }
+      if (aKey == "directory") {
+        _settings.logDirectory = std::string(aValue);
+        return !aValue.empty();
+      }
+      return false;
+    }
+
+    // Applies the "key=value" pairs of aText to _settings, see out::configure()
+    bool parseSettings(std::string_view aText, out::settings &_settings) {
+      auto separator = [](char aChar) {
+        return aChar == ' ' || aChar == '\t' || aChar == '\n' || aChar == '\r' || aChar == ',' || aChar == ';';
+      };
+
+      size_t pos = 0;
+      while (pos < aText.size()) {
+        if (separator(aText[pos])) {
+          ++pos;
+          continue;
+        }
+        if (aText[pos] == '#') {
+          pos = aText.find('\n', pos);
+          continue;
+        }
+
+        // Separators and '#' are part of a value in double quotes, e.g. directory="/var/log/my app"
+        size_t end = pos;
+        bool quoted = false;
+        while (end < aText.size() && (quoted || (!separator(aText[end]) && aText[end] != '#'))) {
+          quoted = quoted != (aText[end] == '"');
+          ++end;
+        }
+        if (quoted) {
+          return false;
+        }
+        std::string_view pair = aText.substr(pos, end - pos);
+        pos = end;
+
+        size_t equals = pair.find('=');
+        if (equals == std::string_view::npos) {
+          return false;
+        }
+        std::string_view value = pair.substr(equals + 1);
+        if (value.size() >= 2 && value.front() == '"' && value.back() == '"') {
+          value = value.substr(1, value.size() - 2);
+        }
+        if (value.find('"') != std::string_view::npos || !parseSetting(pair.substr(0, equals), value, _settings)) {
+          return false;
+        }
+      }
+      return true;
+    }
+
+    // Position of the single bit set in aMask
+    size_t sinkIndex(sinkMask aMask) {
+      size_t index = 0;
+      while (aMask > 1) {
+        aMask >>= 1;
+        ++index;
+      }
+      return index;
+    }
+  }  // namespace
+
+
+  out::container::container() :
+      printTimestamp(false),
+      printLocation(false),
+      sinks(0),
+      thread(0),
+      site(nullptr),
+      verbosity(0),
+      pooled(false),
+      decode(nullptr) {
   }
 
   out::container::container(const out::container &c) :
-      str(c.str),
       printTimestamp(c.printTimestamp),
       printLocation(c.printLocation),
-      os(c.os),
-      ofs(c.ofs),
+      sinks(c.sinks),
       time(c.time),
-      line(c.line),
-      file(c.file),
-      function(c.function),
-      verbosity(c.verbosity) {
+      thread(c.thread),
+      site(c.site),
+      verbosity(c.verbosity),
+      pooled(false),
+      decode(c.decode),
+      body(c.body) {
   }
 
-  out::container::container(const out::container &&c) :
-      str(std::move(c.str)),
-      printTimestamp(std::move(c.printTimestamp)),
-      printLocation(std::move(c.printLocation)),
-      os(std::move(c.os)),
-      ofs(std::move(c.ofs)),
-      time(std::move(c.time)),
-      line(std::move(c.line)),
-      file(std::move(c.file)),
-      function(std::move(c.function)),
-      verbosity(std::move(c.verbosity)) {
+  out::container::container(out::container &&c) noexcept :
+      printTimestamp(c.printTimestamp),
+      printLocation(c.printLocation),
+      sinks(c.sinks),
+      time(c.time),
+      thread(c.thread),
+      site(c.site),
+      verbosity(c.verbosity),
+      pooled(false),
+      decode(c.decode),
+      body(std::move(c.body)) {
   }
 
   out::container::~container() {
   }
 
 
-  out::out() :
-      mEnable(false),
-      mEnableOS(false),
-      mEnableOFS(false),
-      mDefaultTimestamp(true),
-      mDefaultLocation(true),
-      mFlush(true),
-      mNewline(false),
-      mVerbosity(0),
+  void out::container::set(const bool &_printTimestamp,
+                           const bool &_printLocation,
+                           const bool &_os,
+                           const bool &_ofs,
+                           const callSite *_site,
+                           const size_t &_verbosity) {
+    printTimestamp = _printTimestamp;
+    printLocation = _printLocation;
+    // Registered sinks receive everything which is written to std::cerr or the log file
+    sinks = (_os ? SINK_OS : 0) | (_ofs ? SINK_OFS : 0) | (_os || _ofs ? ~(SINK_OS | SINK_OFS) : 0);
+    time = std::chrono::system_clock::now();
+    site = _site;
+    verbosity = _verbosity;
+    thread = threadID();
+    decode = nullptr;
+    body.clear();
+  }
+
+
+  std::string_view out::container::str() const {
+    return body.view();
+  }
+
+
+  out::out(const std::string &aName, std::shared_ptr<workerPool> aPool) : out(aName, std::move(aPool), false) {
+  }
+
+
+  out::out(const std::string &aName, std::shared_ptr<workerPool> aPool, bool aDefault) :
+      mConfig(CONFIG_TIMESTAMP | CONFIG_LOCATION
+              | static_cast<uint32_t>(QUEUE_MODE::LOCK_FREE) << CONFIG_QUEUE_MODE_SHIFT),
+      mCapacity(0),
+      mOverflowPolicy(OVERFLOW_POLICY::BLOCK),
+      mDropVerbosity(1),
+      mOverflowing(false),
+      mEnqueued(0),
+      mCompleted(0),
+      mWaiters(0),
+      mWorkerWaiting(false),
+      mHighWater(0),
+      mDropped(0),
+      mBlockedProducers(0),
+      mRecorderPos(0),
+      mRecorder(new std::atomic<container *>[DBG_OUT_FLIGHT_RECORDER_SIZE]),
+      mFlushPolicy(FLUSH_POLICY::ALWAYS),
+      mFlushThreshold(0),
+      mName(aName),
+      mIsDefault(aDefault),
+      mFileMode(FILE_MODE::STREAM),
+      mTimestampSecond(0),
+      mOFSWritten(0),
+      mUnflushedMessages(0),
+      mUnflushedBytes(0),
+      mLastFlush(std::chrono::steady_clock::now()),
+      mSinksChanged(false),
+      mTraceMask(0),
+      mActiveMask(SINK_OS | SINK_OFS),
+      mActiveTraceMask(0),
+      mBatchConfig(mConfig.load(std::memory_order_relaxed)),
+      mLogFormat(LOG_FORMAT::TEXT),
+      mActiveFormat(LOG_FORMAT::TEXT),
+      mRotateRequested(false),
+      mRotateSize(0),
+      mRotateInterval(0),
+      mCompress(false),
+      mSegmentBytes(0),
+      mSegmentStart(std::chrono::steady_clock::now()),
       mStop(false),
+      mShutdownTimeout(DBG_OUT_SHUTDOWN_TIMEOUT_MS),
+      mFinalDrain(false),
+      mFlushRequested(false),
+      mLastCollect(std::chrono::steady_clock::now()),
+      mWorkerPool(std::move(aPool)),
+      mPoolAttached(false),
+      mPoolStopped(false),
+      mWritten(0),
+      mFormatTime(0),
+      mIOTime(0),
+      mDroppedReported(0),
+      mLastDropReport(),
+      mLastSuppressedReport(),
+      mSuppressedPending(false),
+      mPool(new container[DBG_OUT_POOL_SIZE]),
+      mFreeContainers(DBG_OUT_POOL_SIZE),
+      mRing(DBG_OUT_QUEUE_CAPACITY),
       mMessages(std::queue<container *>()) {
-    // Create logs folder
-    std_filesystem::path path = std_filesystem::current_path();
-    path += std_filesystem::path("/logs");
-    std_filesystem::create_directory(path);
+    for (size_t i = 0; i < DBG_OUT_POOL_SIZE; ++i) {
+      mPool[i].pooled = true;
+      mFreeContainers.push(&mPool[i]);
+    }
 
-    // Set path to log file
-    path += std_filesystem::path(
-      "/Debug Log " + std::to_string(std::chrono::system_clock::to_time_t(std::chrono::system_clock::now())) + ".log");
+    for (size_t i = 0; i < DBG_OUT_FLIGHT_RECORDER_SIZE; ++i) {
+      mRecorder[i].store(nullptr, std::memory_order_relaxed);
+    }
 
-    // Open log file
-    mOFS.open(path.c_str(), std::ofstream::out | std::ofstream::app);
+    for (size_t i = 0; i < LATENCY_BUCKETS; ++i) {
+      mLatency[i].store(0, std::memory_order_relaxed);
+    }
+    for (size_t i = 0; i < SINK_BITS; ++i) {
+      mSinkMessages[i].store(0, std::memory_order_relaxed);
+      mSinkBytes[i].store(0, std::memory_order_relaxed);
+      mBatchMessages[i] = 0;
+    }
 
-    // Start worker
-    mWorker = std::thread(&out::outputThread, this);
+    // The log file is opened by ofsEnable() and the worker is started by enable()
   }  // namespace DBG
 
 
   out::~out() {
+    // The watcher calls configure()
+    mConfigWatcher.stop();
+    flushOnCrash(false);
+
     {
       std::unique_lock<std::mutex> lock(mQueueMutex);
       mStop = true;
     }
 
-    mQueueUpdatedCondition.notify_one();
-    if (mWorker.joinable()) {
-      mWorker.join();
-    }
+    notifyWorker();
+    joinWorker();
 
-    while (!mMessages.empty()) {
-      delete mMessages.front();
-      mMessages.pop();
-    }
+    clearQueue();
 
-    if (mOFS.is_open()) {
-      mOFS.close();
+    closeLog();
+    mCompressor.stop();
+  }
+
+
+  uint32_t out::setConfig(uint32_t aMask, uint32_t aValue) {
+    uint32_t config = mConfig.load(std::memory_order_relaxed);
+    while (!mConfig.compare_exchange_weak(config, (config & ~aMask) | (aValue & aMask), std::memory_order_relaxed)) {
     }
+    return config;
   }
 
 
   bool out::enabled() {
-    return mEnable;
+    return configFlag(CONFIG_ENABLE);
   }
 
 
   void out::enable(const bool &aEnable) {
-    mEnable = aEnable;
+    // The flight recorder does not need the worker
+    if (aEnable && queueMode() != QUEUE_MODE::FLIGHT_RECORDER) {
+      startWorker();
+    }
+
+    {
+      std::unique_lock<std::mutex> lock(mQueueMutex);
+      setConfig(CONFIG_ENABLE, aEnable ? CONFIG_ENABLE : 0);
+    }
+    notifyWorker();
+  }
+
+
+  void out::startWorker() {
+    std::call_once(mWorkerStarted, [this]() {
+      if (mWorkerPool != nullptr) {
+        // Idle until the first notifyWorker()
+        mWorkerWaiting = true;
+        mWorkerPool->attach(this);
+        mPoolAttached = true;
+      }
+      else {
+        mWorker = std::thread(&out::outputThread, this);
+      }
+    });
+  }
+
+
+  void out::joinWorker() {
+    if (mWorker.joinable()) {
+      mWorker.join();
+    }
+
+    if (mPoolAttached) {
+      {
+        std::unique_lock<std::mutex> lock(mTaskFinishedMutex);
+        mTaskFinishedCondition.wait(lock, [this]() {
+          return mPoolStopped;
+        });
+      }
+      mWorkerPool->detach(this);
+      mPoolAttached = false;
+    }
+  }
+
+
+  void out::notifyWorker() {
+    if (mWorkerPool == nullptr) {
+      mQueueUpdatedCondition.notify_one();
+      return;
+    }
+
+    // Whoever finds the logger idle queues it, so it is queued at most once
+    if (mWorkerWaiting.load(std::memory_order_seq_cst) && mWorkerWaiting.exchange(false, std::memory_order_seq_cst)) {
+      mWorkerPool->schedule(this);
+    }
   }
 
 
   void out::disable() {
-    mEnable = false;
+    setConfig(CONFIG_ENABLE, 0);
   }
 
 
@@ -162,165 +551,1758 @@ namespace DBG {
       mStop = true;
     }
 
-    mDisable = true;
+    setConfig(CONFIG_DISABLE, CONFIG_DISABLE);
 
-    mQueueUpdatedCondition.notify_all();
-    if (mWorker.joinable()) {
-      mWorker.join();
+    {
+      std::unique_lock<std::mutex> lock(mSpaceMutex);
+      mSpaceCondition.notify_all();
+    }
+
+    notifyWorker();
+    joinWorker();
+
+    clearQueue();
+
+    closeLog();
+    mCompressor.stop();
+  }
+
+
+  void out::shutdownTimeout(size_t aMilliseconds) {
+    mShutdownTimeout = aMilliseconds;
+  }
+
+
+  out &out::instance(const std::string &aName, std::shared_ptr<workerPool> aPool) {
+    if (aName.empty()) {
+      return instance();
     }
 
-    while (!mMessages.empty()) {
-      delete mMessages.front();
-      mMessages.pop();
+    static std::map<std::string, std::unique_ptr<out>> loggers;
+    std::unique_lock<std::mutex> lock(loggersMutex);
+    std::unique_ptr<out> &logger = loggers[aName];
+    if (logger == nullptr) {
+      logger.reset(new out(aName, std::move(aPool)));
     }
+    return *logger;
+  }
 
-    if (mOFS.is_open()) {
-      mOFS.close();
+
+  const std::string &out::name() const {
+    return mName;
+  }
+
+
+  void out::flushOnCrash(bool aEnable) {
+    std::unique_lock<std::mutex> lock(crashHandlerMutex);
+
+    // An enabled logger takes the first free slot, a disabled one clears its own
+    bool registered = false;
+    for (auto &slot : crashLoggers) {
+      registered = registered || slot.load(std::memory_order_relaxed) == this;
+    }
+    if (registered != aEnable) {
+      out *from = aEnable ? nullptr : this;
+      for (auto &slot : crashLoggers) {
+        if (slot.load(std::memory_order_relaxed) == from) {
+          slot.store(aEnable ? this : nullptr, std::memory_order_relaxed);
+          break;
+        }
+      }
+    }
+
+    bool install = false;
+    for (auto &slot : crashLoggers) {
+      install = install || slot.load(std::memory_order_relaxed) != nullptr;
+    }
+
+    if (install == crashHandlersInstalled) {
+      return;
+    }
+
+    if (install) {
+      for (size_t i = 0; i < CRASH_SIGNAL_COUNT; ++i) {
+        previousSignalHandlers[i] = std::signal(CRASH_SIGNALS[i], &out::crashSignalHandler);
+      }
+      previousTerminateHandler = std::set_terminate(&out::crashTerminateHandler);
+    }
+    else {
+      for (size_t i = 0; i < CRASH_SIGNAL_COUNT; ++i) {
+        std::signal(CRASH_SIGNALS[i], previousSignalHandlers[i] == SIG_ERR ? SIG_DFL : previousSignalHandlers[i]);
+      }
+      std::set_terminate(previousTerminateHandler);
+    }
+    crashHandlersInstalled = install;
+  }
+
+
+  void out::crashSignalHandler(int aSignal) {
+    crashFlushAll();
+
+    // Continue with the handler which was installed before, or the default action
+    void (*previous)(int) = SIG_DFL;
+    for (size_t i = 0; i < CRASH_SIGNAL_COUNT; ++i) {
+      if (CRASH_SIGNALS[i] == aSignal && previousSignalHandlers[i] != SIG_ERR && previousSignalHandlers[i] != SIG_IGN) {
+        previous = previousSignalHandlers[i];
+      }
+    }
+    std::signal(aSignal, previous);
+    std::raise(aSignal);
+  }
+
+
+  void out::crashTerminateHandler() {
+    crashFlushAll();
+
+    if (previousTerminateHandler != nullptr) {
+      previousTerminateHandler();
+    }
+    std::abort();
+  }
+
+
+  void out::crashFlushAll() {
+    for (auto &slot : crashLoggers) {
+      out *logger = slot.load(std::memory_order_relaxed);
+      if (logger != nullptr) {
+        logger->crashFlush();
+      }
+    }
+  }
+
+
+  void out::crashFlush() {
+    if (queueMode() == QUEUE_MODE::FLIGHT_RECORDER) {
+      dumpRecorder(true);
+      return;
+    }
+
+    // Nothing can be written if the worker itself crashed or has already stopped
+    bool onWorker = mPoolAttached ? workerPool::onPoolThread() : std::this_thread::get_id() == mWorker.get_id();
+    if ((!mWorker.joinable() && !mPoolAttached) || onWorker || mStop) {
+      return;
+    }
+
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(mShutdownTimeout);
+    uint64_t target = mEnqueued.load(std::memory_order_relaxed);
+
+    // Polls instead of waiting on a condition variable, the crashing thread may hold any of the mutexes.
+    // The worker is woken repeatedly since a notification can be missed without mQueueMutex.
+    while (mCompleted.load(std::memory_order_acquire) < target) {
+      if (std::chrono::steady_clock::now() >= deadline) {
+        return;
+      }
+      notifyWorker();
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+
+    mFlushRequested = true;
+    while (mFlushRequested && std::chrono::steady_clock::now() < deadline) {
+      notifyWorker();
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
     }
   }
 
 
   bool out::osEnabled() {
-    return mEnableOS;
+    return configFlag(CONFIG_OS);
   }
 
 
   void out::osEnable(const bool &aEnable) {
-    mEnableOS = aEnable;
+    setConfig(CONFIG_OS, aEnable ? CONFIG_OS : 0);
   }
 
 
   void out::osDisable() {
-    mEnableOS = false;
+    setConfig(CONFIG_OS, 0);
   }
 
 
   bool out::ofsEnabled() {
-    return mEnableOFS && mOFS.is_open();
+    return configFlag(CONFIG_OFS) && logOpen();
   }
 
 
   void out::ofsEnable(const bool &aEnable) {
-    mEnableOFS = aEnable && mOFS.is_open();
+    std::unique_lock<std::mutex> lock(mSinkMutex);
+    setConfig(CONFIG_OFS, aEnable && openLog() ? CONFIG_OFS : 0);
   }
 
 
   void out::ofsDisable() {
-    mEnableOFS = false;
+    setConfig(CONFIG_OFS, 0);
   }
 
 
-  uint8_t out::verbosity() {
-    return mVerbosity;
+  out::FILE_MODE out::fileMode() {
+    return mFileMode;
   }
 
 
-  void out::verbosity(uint8_t aVerbosity) {
-    mVerbosity = aVerbosity;
+  bool out::fileMode(FILE_MODE aMode) {
+    std::unique_lock<std::mutex> lock(mSinkMutex);
+    return switchFileMode(aMode);
   }
 
 
-  std::string out::getLogFilename() {
-    mEnableOFS = false;
-    return mLogFilename;
+  bool out::switchFileMode(FILE_MODE aMode) {
+    if (aMode == mFileMode) {
+      return true;
+    }
+
+    // Applied when the log file is opened
+    if (!logOpen()) {
+      mFileMode = aMode;
+      return true;
+    }
+
+    // Every mode appends to the same log file
+    closeLog();
+    if (!openBackend(aMode)) {
+      openBackend(FILE_MODE::STREAM);
+      mFileMode = FILE_MODE::STREAM;
+      return false;
+    }
+
+    mFileMode = aMode;
+    return true;
   }
 
 
-  void out::flush(bool aFlush) {
-    mFlush = aFlush;
+  bool out::logOpen() {
+    return mOFS.is_open() || mMappedFile.isOpen() || mAsyncFile.isOpen();
   }
 
 
-  void out::newline(bool aNewline) {
-    mNewline = aNewline;
+  bool out::openBackend(FILE_MODE aMode) {
+    switch (aMode) {
+      case FILE_MODE::MMAP:
+        return mMappedFile.open(mLogFilename);
+      case FILE_MODE::AIO:
+        return mAsyncFile.open(mLogFilename);
+      case FILE_MODE::STREAM:
+        break;
+    }
+    mOFS.open(mLogFilename, std::ofstream::out | std::ofstream::app);
+    return mOFS.is_open();
   }
 
 
-  void out::outputThread() {
-    // run tasks in queue until mStop == true || mMessages.empty()
-    for (;;) {
-      container *c;
+  void out::closeLog() {
+    if (mOFS.is_open()) {
+      mOFS.close();
+    }
+    mMappedFile.close();
+    mAsyncFile.close();
+  }
 
-      {
-        std::unique_lock<std::mutex> lock(mQueueMutex);
-        mQueueUpdatedCondition.wait(lock, [this]() {
-          return (mStop || (mEnable && !mMessages.empty()));
-        });
 
-        // End the worker thread immediately if it is asked to stop
-        if (mStop) {
-          return;
-        }
-        else {
-          c = mMessages.front();
-        }
-      }
+  bool out::openLog() {
+    if (logOpen()) {
+      return true;
+    }
 
-      if (mVerbosity >= c->verbosity) {
-        std::string outputStr = "";
+    // Failures show up as a log file which can not be opened
+    std::error_code error;
+    if (mLogDirectory.empty()) {
+      mLogDirectory = (std_filesystem::current_path(error) / "logs").string();
+    }
+    std_filesystem::create_directories(mLogDirectory, error);
 
-        if (c->printTimestamp == true) {
-          outputStr += getTimestamp(c->time) + " - ";
-        }
+    mActiveFormat = mLogFormat;
+    mLogFilename = nextLogFilename();
+    if (mFileMode == FILE_MODE::STREAM || !openBackend(mFileMode)) {
+      openBackend(FILE_MODE::STREAM);
+      mFileMode = FILE_MODE::STREAM;
+    }
 
-        if (c->printLocation == true) {
-          outputStr += c->file + ":" + c->function + ":" + std::to_string(c->line) + "\t - ";
-        }
+    mSegmentBytes = 0;
+    mSegmentStart = std::chrono::steady_clock::now();
 
-        outputStr += c->str;
+    // Every binary file starts with its own header and site table
+    if (mActiveFormat == LOG_FORMAT::BINARY) {
+      std::string header;
+      mBinaryWriter.begin(header);
+      writeLog(header);
+    }
 
-        if (mNewline) {
-          outputStr += "\n";
-        }
+    return logOpen();
+  }
 
-        if (c->os && mEnableOS) {
-          std::cerr << outputStr;
-          if (mFlush) {
-            std::cerr << std::flush;
-          }
-        }
 
-        if (c->ofs && mEnableOFS && mOFS.is_open()) {
-          mOFS << outputStr;
-          if (mFlush) {
-            mOFS << std::flush;
-          }
-        }
-      }
+  bool out::logDirectory(const std::string &aDirectory) {
+    std::unique_lock<std::mutex> lock(mSinkMutex);
+    if (logOpen()) {
+      return false;
+    }
+    mLogDirectory = aDirectory;
+    return true;
+  }
 
-      {
-        std::unique_lock<std::mutex> lock(mQueueMutex);
-        delete c;
-        mMessages.pop();
-      }
 
-      mTaskFinishedCondition.notify_all();
+  bool out::logFilename(const std::string &aFilename) {
+    std::unique_lock<std::mutex> lock(mSinkMutex);
+    if (logOpen()) {
+      return false;
     }
+    mLogName = aFilename;
+    return true;
   }
 
 
-  void out::wait() {
-    while (!mMessages.empty()) {
-      std::unique_lock<std::mutex> lock(mTaskFinishedMutex);
-      mTaskFinishedCondition.wait(lock, [this]() {
-        return mMessages.empty();
-      });
+  uint8_t out::verbosity() {
+    return static_cast<uint8_t>((mConfig.load(std::memory_order_relaxed) & CONFIG_VERBOSITY) >> CONFIG_VERBOSITY_SHIFT);
+  }
+
+
+  void out::verbosity(uint8_t aVerbosity) {
+    setConfig(CONFIG_VERBOSITY, static_cast<uint32_t>(aVerbosity) << CONFIG_VERBOSITY_SHIFT);
+  }
+
+
+  size_t out::callSiteEnable(const std::string &aFile, int aLine, bool aEnable) {
+    size_t count = 0;
+    callSite::forEach([&](callSite &site) {
+      std::string_view file(site.file);
+      if ((aLine == 0 || site.line == aLine) && file.size() >= aFile.size()
+          && file.compare(file.size() - aFile.size(), aFile.size(), aFile) == 0) {
+        site.enable(aEnable);
+        ++count;
+      }
+    });
+    return count;
+  }
+
+
+  std::string out::getLogFilename() {
+    std::unique_lock<std::mutex> lock(mSinkMutex);
+    return mLogFilename;
+  }
+
+
+  void out::rotateSize(size_t aBytes) {
+    mRotateSize = aBytes;
+  }
+
+
+  void out::rotateInterval(size_t aSeconds) {
+    mRotateInterval = aSeconds;
+  }
+
+
+  out::LOG_FORMAT out::logFormat() {
+    return mLogFormat;
+  }
+
+
+  void out::logFormat(LOG_FORMAT aFormat) {
+    std::unique_lock<std::mutex> lock(mSinkMutex);
+    // A log file which is not open yet simply starts in the new format
+    if (mLogFormat.exchange(aFormat) != aFormat && logOpen()) {
+      mRotateRequested = true;
     }
   }
 
 
-  size_t out::remainingMessages() {
-    std::unique_lock<std::mutex> lock(mQueueMutex);
-    return mMessages.size();
+  void out::compressRotated(bool aCompress) {
+    mCompress = aCompress;
   }
 
 
-  std::string out::getTimestamp(std::chrono::system_clock::time_point time) {
-    UTL::timeType<size_t> time_type(UTL::timeType<size_t>::TIME_ZONE::LOCAL, time);
-    time_t rawtime = std::chrono::system_clock::to_time_t(time);
-    auto timeinfo = localtime(&rawtime);
-    char buffer[80];
-    strftime(buffer, 80, "%h %d, %Y", timeinfo);
-    return std::string(buffer) + " " + time_type.to_string();
+  out::settings out::configuration() {
+    std::unique_lock<std::mutex> lock(mSinkMutex);
+    uint32_t config = mConfig.load(std::memory_order_relaxed);
+
+    settings current;
+    current.enabled = config & CONFIG_ENABLE;
+    current.os = config & CONFIG_OS;
+    current.ofs = config & CONFIG_OFS;
+    current.timestamp = config & CONFIG_TIMESTAMP;
+    current.location = config & CONFIG_LOCATION;
+    current.newline = config & CONFIG_NEWLINE;
+    current.deferred = config & CONFIG_DEFERRED;
+    current.verbosity = static_cast<uint8_t>((config & CONFIG_VERBOSITY) >> CONFIG_VERBOSITY_SHIFT);
+    current.flushPolicy = mFlushPolicy;
+    current.flushThreshold = mFlushThreshold;
+    current.rotateSize = mRotateSize;
+    current.rotateInterval = mRotateInterval;
+    current.logFormat = mLogFormat;
+    current.fileMode = mFileMode;
+    current.logDirectory = mLogDirectory;
+    return current;
+  }
+
+
+  bool out::configure(const settings &aSettings) {
+    std::unique_lock<std::mutex> lock(mConfigureMutex);
+    return applySettings(aSettings);
+  }
+
+
+  bool out::configure(const std::string &aText) {
+    std::unique_lock<std::mutex> lock(mConfigureMutex);
+    settings updated = configuration();
+    if (!parseSettings(aText, updated)) {
+      return false;
+    }
+    return applySettings(updated);
+  }
+
+
+  bool out::configureFromEnvironment(const char *aVariable) {
+    const char *value = std::getenv(aVariable);
+    return value != nullptr && configure(std::string(value));
+  }
+
+
+  bool out::configureFromFile(const std::string &aPath) {
+    std::ifstream file(aPath);
+    if (!file.is_open()) {
+      return false;
+    }
+    return configure(std::string((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>()));
+  }
+
+
+  void out::watchConfig(const std::string &aPath, size_t aMilliseconds) {
+    if (aPath.empty()) {
+      mConfigWatcher.stop();
+      return;
+    }
+    mConfigWatcher.watch(aPath, aMilliseconds, [this](const std::string &aText) {
+      configure(aText);
+    });
+  }
+
+
+  bool out::applySettings(const settings &aSettings) {
+    // The flight recorder does not need the worker
+    if (aSettings.enabled && queueMode() != QUEUE_MODE::FLIGHT_RECORDER) {
+      startWorker();
+    }
+
+    bool opened = true;
+    {
+      std::unique_lock<std::mutex> lock(mSinkMutex);
+
+      mFlushThreshold = aSettings.flushThreshold;
+      mFlushPolicy = aSettings.flushPolicy;
+      mRotateSize = aSettings.rotateSize;
+      mRotateInterval = aSettings.rotateInterval;
+
+      // Both take effect with the next log file
+      if (mLogFormat.exchange(aSettings.logFormat) != aSettings.logFormat && logOpen()) {
+        mRotateRequested = true;
+      }
+      if (!aSettings.logDirectory.empty() && aSettings.logDirectory != mLogDirectory) {
+        mLogDirectory = aSettings.logDirectory;
+        mRotateRequested = mRotateRequested || logOpen();
+      }
+
+      opened = switchFileMode(aSettings.fileMode);
+      bool ofs = aSettings.ofs && openLog();
+      opened = opened && ofs == aSettings.ofs;
+
+      uint32_t value = (aSettings.enabled ? CONFIG_ENABLE : 0) | (aSettings.os ? CONFIG_OS : 0)
+                       | (ofs ? CONFIG_OFS : 0) | (aSettings.timestamp ? CONFIG_TIMESTAMP : 0)
+                       | (aSettings.location ? CONFIG_LOCATION : 0) | (aSettings.newline ? CONFIG_NEWLINE : 0)
+                       | (aSettings.deferred ? CONFIG_DEFERRED : 0)
+                       | static_cast<uint32_t>(aSettings.verbosity) << CONFIG_VERBOSITY_SHIFT;
+      setConfig(CONFIG_ENABLE | CONFIG_OS | CONFIG_OFS | CONFIG_TIMESTAMP | CONFIG_LOCATION | CONFIG_NEWLINE
+                  | CONFIG_DEFERRED | CONFIG_VERBOSITY,
+                value);
+    }
+
+    // A worker which just found the logger disabled is either asleep or has not yet started waiting
+    {
+      std::unique_lock<std::mutex> lock(mQueueMutex);
+    }
+    notifyWorker();
+    return opened;
+  }
+
+
+  sinkMask out::addSink(std::shared_ptr<sink> aSink) {
+    std::unique_lock<std::mutex> lock(mSinkMutex);
+    return registerSink(std::move(aSink));
+  }
+
+
+  sinkMask out::traceSink(std::shared_ptr<sink> aSink) {
+    sinkMask mask = setTraceSink(std::move(aSink));
+    // A batch which is already being rendered uses the old sinks, records queued after it would be lost
+    wait();
+    return mask;
+  }
+
+
+  sinkMask out::setTraceSink(std::shared_ptr<sink> aSink) {
+    std::unique_lock<std::mutex> lock(mSinkMutex);
+    sinkMask previous = mTraceMask.load(std::memory_order_relaxed);
+    for (auto it = mSinks.begin(); it != mSinks.end(); ++it) {
+      if (it->mask == previous) {
+        // Frees a bit, so registering the new sink can not fail
+        std::unique_lock<std::mutex> listLock(mSinkListMutex);
+        mSinks.erase(it);
+        break;
+      }
+    }
+
+    sink *target = aSink.get();
+    sinkMask mask = registerSink(std::move(aSink));
+    if (mask == 0) {
+      return 0;
+    }
+
+    // The worker picks up the sink under mSinkMutex, no batch is written ahead of this
+    target->write("[\n", 2);
+    mTraceMask.store(mask, std::memory_order_relaxed);
+    return mask;
+  }
+
+
+  void out::trace(callSite &site, size_t verbosity, const char *aName, uint64_t aStart, uint64_t aEnd) {
+    if (!accepts(verbosity)) {
+      return;
+    }
+
+    sinkMask traceMask = mTraceMask.load(std::memory_order_relaxed);
+    container *c;
+    if (traceMask != 0) {
+      c = acquire(false, false, false, false, site, verbosity);
+      c->sinks = traceMask;
+      c->decode = &decodeTrace;
+    }
+    else {
+      uint32_t config = mConfig.load(std::memory_order_relaxed);
+      c = acquire(config & CONFIG_TIMESTAMP, config & CONFIG_LOCATION, true, true, site, verbosity);
+      c->decode = &decodeScope;
+    }
+    encode(c->body, aName, aStart, aEnd, c->thread);
+    enqueue(c);
+  }
+
+
+  sinkMask out::registerSink(std::shared_ptr<sink> aSink) {
+    // Bits 0 and 1 are std::cerr and the log file
+    sinkMask used = SINK_OS | SINK_OFS;
+    for (auto &registered : mSinks) {
+      used |= registered.mask;
+    }
+
+    if (used == SINK_ALL) {
+      return 0;
+    }
+
+    sinkMask mask = 1;
+    while (used & mask) {
+      mask <<= 1;
+    }
+
+    // The bit may have belonged to a removed sink
+    mSinkMessages[sinkIndex(mask)].store(0, std::memory_order_relaxed);
+    mSinkBytes[sinkIndex(mask)].store(0, std::memory_order_relaxed);
+
+    bool records = aSink->wantsRecords();
+    std::unique_lock<std::mutex> listLock(mSinkListMutex);
+    mSinks.push_back({mask, std::move(aSink), records});
+    mSinksChanged = true;
+    return mask;
+  }
+
+
+  void out::removeSink(sinkMask aSink) {
+    std::unique_lock<std::mutex> lock(mSinkMutex);
+    for (auto it = mSinks.begin(); it != mSinks.end(); ++it) {
+      if (it->mask == aSink) {
+        {
+          std::unique_lock<std::mutex> listLock(mSinkListMutex);
+          mSinks.erase(it);
+        }
+        mSinksChanged = true;
+        if (mTraceMask.load(std::memory_order_relaxed) == aSink) {
+          mTraceMask.store(0, std::memory_order_relaxed);
+        }
+        return;
+      }
+    }
+  }
+
+
+  std::string out::nextLogFilename() {
+    std::string base
+      = mLogDirectory + "/"
+        + (mLogName.empty()
+             ? (mName.empty() ? "Debug" : mName) + " Log "
+                 + std::to_string(std::chrono::system_clock::to_time_t(std::chrono::system_clock::now()))
+             : mLogName);
+
+    // Rotating more than once per second must not reopen the previous file, or reuse the name of one which has
+    // been compressed: its .gz would be replaced once the new file is compressed too
+    std::string extension = mLogFormat == LOG_FORMAT::BINARY ? ".dbg" : ".log";
+    std::string filename = base + extension;
+    for (size_t i = 1; std_filesystem::exists(filename) || std_filesystem::exists(filename + ".gz"); ++i) {
+      filename = base + " (" + std::to_string(i) + ")" + extension;
+    }
+
+    return filename;
+  }
+
+
+  bool out::rotationDue() {
+    size_t size = mRotateSize;
+    size_t interval = mRotateInterval;
+
+    return (size != 0 && mSegmentBytes >= size)
+           || (interval != 0 && std::chrono::steady_clock::now() - mSegmentStart >= std::chrono::seconds(interval));
+  }
+
+
+  bool out::rotateBefore(size_t aBytes) {
+    size_t limit = mRotateSize.load(std::memory_order_relaxed);
+    if (limit == 0) {
+      return false;
+    }
+
+    // A file which holds no message yet is kept, even if the message alone is larger than the limit
+    size_t header = mActiveFormat == LOG_FORMAT::BINARY ? sizeof(binaryLog::MAGIC) + sizeof(binaryLog::VERSION) : 0;
+    size_t segment = mSegmentBytes.load(std::memory_order_relaxed) + mOFSBuffer.size();
+    if (segment <= header || segment + aBytes <= limit) {
+      return false;
+    }
+
+    std::unique_lock<std::mutex> lock(mSinkMutex);
+    if (!logOpen()) {
+      return false;
+    }
+    writeLog(mOFSBuffer);
+    mOFSWritten += mOFSBuffer.size();
+    mOFSBuffer.clear();
+    rotate();
+    return true;
+  }
+
+
+  void out::writeLog(const std::string &aData) {
+    mSegmentBytes += aData.size();
+    if (mMappedFile.isOpen()) {
+      if (mMappedFile.write(aData.data(), aData.size())) {
+        return;
+      }
+      // The file could not be grown and has been closed, it continues in STREAM mode
+      mFileMode = FILE_MODE::STREAM;
+      openBackend(FILE_MODE::STREAM);
+    }
+    else if (mAsyncFile.isOpen()) {
+      mAsyncFile.write(aData.data(), aData.size());
+      return;
+    }
+
+    if (mOFS.is_open()) {
+      mOFS.write(aData.data(), static_cast<std::streamsize>(aData.size()));
+    }
+  }
+
+
+  void out::rotate() {
+    std::string closed = mLogFilename;
+
+    // The new file uses the backend of the old one, closing waits for its writes to complete
+    closeLog();
+    openLog();
+
+    if (mCompress) {
+      mCompressor.add(closed);
+    }
+  }
+
+
+  void out::flush(bool aFlush) {
+    flush(aFlush ? FLUSH_POLICY::ALWAYS : FLUSH_POLICY::MANUAL);
+  }
+
+
+  void out::flush(FLUSH_POLICY aPolicy, size_t aThreshold) {
+    mFlushThreshold = aThreshold;
+    mFlushPolicy = aPolicy;
+    notifyWorker();
+  }
+
+
+  void out::newline(bool aNewline) {
+    setConfig(CONFIG_NEWLINE, aNewline ? CONFIG_NEWLINE : 0);
+  }
+
+
+  bool out::deferredFormatting() {
+    return configFlag(CONFIG_DEFERRED);
+  }
+
+
+  void out::deferredFormatting(bool aDeferred) {
+    setConfig(CONFIG_DEFERRED, aDeferred ? CONFIG_DEFERRED : 0);
+  }
+
+
+  out::container *out::acquire(const bool &_printTimestamp,
+                               const bool &_printLocation,
+                               const bool &_os,
+                               const bool &_ofs,
+                               callSite &_site,
+                               const size_t &_verbosity) {
+    _site.registerSite();
+
+    container *c;
+    if (!mFreeContainers.pop(c)) {
+      c = new container();
+    }
+    c->set(_printTimestamp, _printLocation, _os, _ofs, &_site, _verbosity);
+    return c;
+  }
+
+
+  callSite &out::locationSite(int aLine, const char *aFile, const char *aFunction) {
+    return callSite::intern(aFile, aFunction, aLine);
+  }
+
+
+  callSite &out::locationSite(int aLine, const std::string &aFile, const std::string &aFunction) {
+    return callSite::intern(aFile, aFunction, aLine);
+  }
+
+
+  void out::release(container *c) {
+    if (c->pooled) {
+      mFreeContainers.push(c);
+    }
+    else {
+      delete c;
+    }
+  }
+
+
+  void out::enqueue(container *c) {
+    // Recorded messages are never queued, wait() and the queue capacity do not apply to them
+    if (queueMode() == QUEUE_MODE::FLIGHT_RECORDER) {
+      record(c);
+      return;
+    }
+
+    size_t capacity = mCapacity.load(std::memory_order_relaxed);
+    if (capacity != 0 && pending() >= capacity && !makeRoom(c, capacity)) {
+      release(c);
+      mDropped.fetch_add(1, std::memory_order_relaxed);
+      return;
+    }
+
+    QUEUE_MODE mode = queueMode();
+
+    // Thread buffers are counted when they are handed off. The push below publishes the count to the worker.
+    if (mode == QUEUE_MODE::THREAD_LOCAL) {
+      threadBuffer &buffer = localBuffer();
+      std::vector<container *> batch;
+      {
+        std::unique_lock<std::mutex> lock(buffer.mutex);
+        buffer.messages.push_back(c);
+        if (buffer.messages.size() < DBG_OUT_THREAD_BUFFER_SIZE) {
+          return;
+        }
+        batch.reserve(DBG_OUT_THREAD_BUFFER_SIZE);
+        batch.swap(buffer.messages);
+      }
+      handOff(std::move(batch));
+      return;
+    }
+
+    mEnqueued.fetch_add(1, std::memory_order_relaxed);
+
+    if (mode == QUEUE_MODE::LOCK_FREE && !mOverflowing.load(std::memory_order_relaxed) && mRing.push(c)) {
+      // Only take the mutex if the worker is (about to be) asleep
+      std::atomic_thread_fence(std::memory_order_seq_cst);
+      if (!mWorkerWaiting.load(std::memory_order_relaxed)) {
+        return;
+      }
+      std::unique_lock<std::mutex> lock(mQueueMutex);
+    }
+    else {
+      std::unique_lock<std::mutex> lock(mQueueMutex);
+      mMessages.push(c);
+      // Until the worker has drained mMessages, a message pushed to the ring would overtake c
+      mOverflowing.store(true, std::memory_order_relaxed);
+    }
+
+    notifyWorker();
+  }
+
+
+  void out::record(container *c) {
+    size_t pos = mRecorderPos.fetch_add(1, std::memory_order_relaxed);
+    container *replaced = mRecorder[pos % DBG_OUT_FLIGHT_RECORDER_SIZE].exchange(c, std::memory_order_acq_rel);
+    if (replaced != nullptr) {
+      release(replaced);
+    }
+  }
+
+
+  size_t out::dump() {
+    return dumpRecorder(false);
+  }
+
+
+  size_t out::dumpRecorder(bool aCrash) {
+    std::vector<container *> records;
+    records.reserve(DBG_OUT_FLIGHT_RECORDER_SIZE);
+
+    // Starting at the next slot to be overwritten visits the oldest message first
+    size_t pos = mRecorderPos.load(std::memory_order_relaxed);
+    for (size_t i = 0; i < DBG_OUT_FLIGHT_RECORDER_SIZE; ++i) {
+      container *c = mRecorder[(pos + i) % DBG_OUT_FLIGHT_RECORDER_SIZE].exchange(nullptr, std::memory_order_acq_rel);
+      if (c != nullptr) {
+        records.push_back(c);
+      }
+    }
+
+    // Producers may have overtaken the scan
+    std::stable_sort(records.begin(), records.end(), [](const container *a, const container *b) {
+      return a->time < b->time;
+    });
+
+    // Formatted on the calling thread with its own buffers, the worker may be running
+    std::string output;
+    messageBuffer decodeBuffer;
+    time_t second = 0;
+    std::string date;
+    bool newline = configFlag(CONFIG_NEWLINE);
+    for (container *c : records) {
+      std::string_view body = c->str();
+      if (c->decode != nullptr) {
+        decodeBuffer.clear();
+        c->decode(body, decodeBuffer);
+        body = decodeBuffer.view();
+      }
+      appendLine(output, *c, body, newline, second, date);
+      release(c);
+    }
+
+    if (output.empty()) {
+      return records.size();
+    }
+
+    // A crashing thread may hold mSinkMutex
+    std::unique_lock<std::mutex> lock(mSinkMutex, std::defer_lock);
+    if (aCrash) {
+      auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(mShutdownTimeout);
+      while (!lock.try_lock() && std::chrono::steady_clock::now() < deadline) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+      }
+    }
+    else {
+      lock.lock();
+    }
+
+    if (lock.owns_lock() && configFlag(CONFIG_OFS) && logOpen() && mActiveFormat == LOG_FORMAT::TEXT) {
+      writeLog(output);
+      if (mOFS.is_open()) {
+        mOFS.flush();
+      }
+      mMappedFile.flush();
+      mAsyncFile.flush();
+      mAsyncFile.sync();
+    }
+    else {
+      std::cerr.write(output.data(), static_cast<std::streamsize>(output.size()));
+      std::cerr.flush();
+    }
+    return records.size();
+  }
+
+
+  bool out::makeRoom(container *c, size_t aCapacity) {
+    switch (mOverflowPolicy.load(std::memory_order_relaxed)) {
+      case OVERFLOW_POLICY::BLOCK: {
+        std::unique_lock<std::mutex> lock(mSpaceMutex);
+        mBlockedProducers.fetch_add(1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        mSpaceCondition.wait(lock, [this, aCapacity]() {
+          return pending() < aCapacity || configFlag(CONFIG_DISABLE);
+        });
+        mBlockedProducers.fetch_sub(1, std::memory_order_relaxed);
+        return !configFlag(CONFIG_DISABLE);
+      }
+      case OVERFLOW_POLICY::DROP_NEWEST:
+        return false;
+      case OVERFLOW_POLICY::DROP_OLDEST:
+        return dropOldest();
+      case OVERFLOW_POLICY::DROP_VERBOSE:
+        return c->verbosity < mDropVerbosity.load(std::memory_order_relaxed);
+    }
+    return false;
+  }
+
+
+  bool out::dropOldest() {
+    container *oldest = nullptr;
+
+    // The ring buffer holds the oldest messages, then the mutex queue, then the handed-off thread buffers.
+    // Messages still in a thread's buffer are not counted by pending(), dropping them would not make room.
+    if (!mRing.pop(oldest)) {
+      std::unique_lock<std::mutex> lock(mQueueMutex);
+      if (!mMessages.empty()) {
+        oldest = mMessages.front();
+        mMessages.pop();
+      }
+      else {
+        // Each batch is in order, the oldest message is at the front of one of them
+        auto batch = mBatches.end();
+        for (auto it = mBatches.begin(); it != mBatches.end(); ++it) {
+          if (!it->empty() && (batch == mBatches.end() || it->front()->time < batch->front()->time)) {
+            batch = it;
+          }
+        }
+        if (batch != mBatches.end()) {
+          oldest = batch->front();
+          batch->erase(batch->begin());
+          if (batch->empty()) {
+            mBatches.erase(batch);
+          }
+        }
+      }
+    }
+
+    if (oldest == nullptr) {
+      return false;
+    }
+
+    release(oldest);
+    mDropped.fetch_add(1, std::memory_order_relaxed);
+    complete(1);
+    return true;
+  }
+
+
+  out::threadBuffer &out::localBuffer() {
+    // Hands any remaining messages to the owning logger when the thread exits
+    struct threadBuffers {
+      ~threadBuffers() {
+        for (auto &buffer : buffers) {
+          std::vector<container *> batch;
+          std::unique_lock<std::mutex> lock(buffer->mutex);
+          out *owner = buffer->owner;
+          if (owner != nullptr && !buffer->messages.empty()) {
+            batch.swap(buffer->messages);
+            owner->handOff(std::move(batch));
+          }
+        }
+      }
+
+      std::vector<std::shared_ptr<threadBuffer>> buffers;
+    };
+
+    static thread_local threadBuffers tBuffers;
+
+    // clearQueue() clears the owner of every buffer when its logger shuts down. Those buffers are removed here,
+    // so a thread which outlives many loggers only scans the ones which are still alive.
+    std::vector<std::shared_ptr<threadBuffer>> &buffers = tBuffers.buffers;
+    for (size_t i = 0; i < buffers.size();) {
+      out *owner = buffers[i]->owner.load(std::memory_order_relaxed);
+      if (owner == this) {
+        return *buffers[i];
+      }
+      if (owner == nullptr) {
+        buffers[i] = std::move(buffers.back());
+        buffers.pop_back();
+        continue;
+      }
+      ++i;
+    }
+
+    auto buffer = std::make_shared<threadBuffer>();
+    buffer->owner = this;
+    buffer->messages.reserve(DBG_OUT_THREAD_BUFFER_SIZE);
+
+    {
+      std::unique_lock<std::mutex> lock(mThreadBuffersMutex);
+      mThreadBuffers.push_back(buffer);
+    }
+
+    buffers.push_back(buffer);
+    return *buffer;
+  }
+
+
+  void out::handOff(std::vector<container *> &&aBatch) {
+    mEnqueued.fetch_add(aBatch.size(), std::memory_order_relaxed);
+    {
+      std::unique_lock<std::mutex> lock(mQueueMutex);
+      mBatches.push_back(std::move(aBatch));
+    }
+    notifyWorker();
+  }
+
+
+  void out::collectThreadBuffers() {
+    std::vector<std::vector<container *>> batches;
+
+    {
+      std::unique_lock<std::mutex> lock(mThreadBuffersMutex);
+      for (auto it = mThreadBuffers.begin(); it != mThreadBuffers.end();) {
+        {
+          std::unique_lock<std::mutex> bufferLock((*it)->mutex);
+          if (!(*it)->messages.empty()) {
+            batches.emplace_back();
+            batches.back().swap((*it)->messages);
+          }
+        }
+
+        // Drop buffers whose thread has exited
+        if (it->use_count() == 1) {
+          it = mThreadBuffers.erase(it);
+        }
+        else {
+          ++it;
+        }
+      }
+    }
+
+    if (batches.empty()) {
+      return;
+    }
+
+    size_t count = 0;
+    for (auto &batch : batches) {
+      count += batch.size();
+    }
+    mEnqueued.fetch_add(count, std::memory_order_relaxed);
+
+    {
+      std::unique_lock<std::mutex> lock(mQueueMutex);
+      for (auto &batch : batches) {
+        mBatches.push_back(std::move(batch));
+      }
+    }
+    notifyWorker();
+  }
+
+
+  void out::clearQueue() {
+    container *c;
+    while (mRing.pop(c)) {
+      release(c);
+    }
+
+    // Producers which are still logging push to these under mQueueMutex, as in drain()
+    std::queue<container *> messages;
+    std::vector<std::vector<container *>> batches;
+    {
+      std::unique_lock<std::mutex> lock(mQueueMutex);
+      std::swap(messages, mMessages);
+      std::swap(batches, mBatches);
+      mOverflowing.store(false, std::memory_order_relaxed);
+    }
+
+    while (!messages.empty()) {
+      release(messages.front());
+      messages.pop();
+    }
+
+    for (auto &batch : batches) {
+      for (auto m : batch) {
+        release(m);
+      }
+    }
+
+    {
+      std::unique_lock<std::mutex> lock(mThreadBuffersMutex);
+      for (auto &buffer : mThreadBuffers) {
+        std::unique_lock<std::mutex> bufferLock(buffer->mutex);
+        buffer->owner = nullptr;
+        for (auto m : buffer->messages) {
+          release(m);
+        }
+        buffer->messages.clear();
+      }
+      mThreadBuffers.clear();
+    }
+
+    // The flight recorder is only written on request
+    for (size_t i = 0; i < DBG_OUT_FLIGHT_RECORDER_SIZE; ++i) {
+      container *r = mRecorder[i].exchange(nullptr, std::memory_order_acq_rel);
+      if (r != nullptr) {
+        release(r);
+      }
+    }
+
+    // Anything left was not written before the shutdown timeout
+    size_t discarded = pending();
+    mDropped.fetch_add(discarded, std::memory_order_relaxed);
+    complete(discarded);
+  }
+
+
+  bool out::queueEmpty() {
+    return mRing.empty() && mMessages.empty() && mBatches.empty();
+  }
+
+
+  void out::outputThread() {
+    const auto collectPeriod = std::chrono::milliseconds(DBG_OUT_THREAD_BUFFER_FLUSH_MS);
+
+    // run tasks in queue until mStop == true, then write what is left
+    for (;;) {
+      if (mStop) {
+        finalDrain();
+        return;
+      }
+
+      bool flushPending = false;
+      if (step(flushPending)) {
+        continue;
+      }
+
+      std::unique_lock<std::mutex> lock(mQueueMutex);
+      mWorkerWaiting = true;
+      std::atomic_thread_fence(std::memory_order_seq_cst);
+      // Switching to THREAD_LOCAL wakes the worker to start the collection timer
+      bool threadLocal = queueMode() == QUEUE_MODE::THREAD_LOCAL;
+      auto predicate = [this, threadLocal]() {
+        return (mStop || mFlushRequested || (configFlag(CONFIG_ENABLE) && !queueEmpty())
+                || (!threadLocal && queueMode() == QUEUE_MODE::THREAD_LOCAL));
+      };
+      // Wake up for whichever timer is due first
+      std::chrono::milliseconds timeout = std::chrono::milliseconds::max();
+      if (threadLocal) {
+        timeout = std::min(timeout, collectPeriod);
+      }
+      if (flushPending) {
+        timeout = std::min(timeout, std::chrono::milliseconds(mFlushThreshold));
+      }
+      if (mDropped.load(std::memory_order_relaxed) != mDroppedReported || mSuppressedPending) {
+        timeout = std::min(timeout, std::chrono::milliseconds(DBG_OUT_DROP_REPORT_MS));
+      }
+
+      if (timeout != std::chrono::milliseconds::max()) {
+        mQueueUpdatedCondition.wait_for(lock, timeout, predicate);
+      }
+      else {
+        mQueueUpdatedCondition.wait(lock, predicate);
+      }
+      mWorkerWaiting = false;
+    }
+  }
+
+
+  bool out::step(bool &_flushPending) {
+    // Pick up partially filled thread buffers on a timer
+    if (queueMode() == QUEUE_MODE::THREAD_LOCAL
+        && std::chrono::steady_clock::now() - mLastCollect >= std::chrono::milliseconds(DBG_OUT_THREAD_BUFFER_FLUSH_MS)) {
+      collectThreadBuffers();
+      mLastCollect = std::chrono::steady_clock::now();
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    bool enabled = configFlag(CONFIG_ENABLE);
+    size_t count = enabled ? drain() : 0;
+    bool report = enabled && reportDrops();
+    // The rate limited macros only log to instance(), other loggers must not take its reports
+    report = (enabled && mIsDefault && reportSuppressed()) || report;
+    if (count != 0 || report) {
+      mFormatTime.fetch_add(static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                                                    std::chrono::steady_clock::now() - start)
+                                                    .count()),
+                            std::memory_order_relaxed);
+      writeBatch(count);
+      return true;
+    }
+
+    if (mFlushRequested) {
+      std::unique_lock<std::mutex> lock(mSinkMutex);
+      flushSinks(true);
+      mFlushRequested = false;
+    }
+
+    // Interval flushes still have to happen while no messages arrive
+    if (mFlushPolicy == FLUSH_POLICY::INTERVAL) {
+      std::unique_lock<std::mutex> lock(mSinkMutex);
+      flushSinks(false);
+      _flushPending = mUnflushedMessages != 0;
+    }
+    return false;
+  }
+
+
+  bool out::poolRun() {
+    for (size_t i = 0; i < DBG_OUT_POOL_BATCHES; ++i) {
+      if (mStop) {
+        finalDrain();
+        // Notified under the mutex, the logger may be destroyed as soon as joinWorker() sees mPoolStopped
+        std::unique_lock<std::mutex> lock(mTaskFinishedMutex);
+        mPoolStopped = true;
+        mTaskFinishedCondition.notify_all();
+        return false;
+      }
+
+      bool flushPending = false;
+      if (!step(flushPending)) {
+        // Go idle, unless work arrived before producers could see the logger was idle.
+        // Timers are served by the pool's tick, see DBG_OUT_POOL_TICK_MS.
+        std::unique_lock<std::mutex> lock(mQueueMutex);
+        mWorkerWaiting = true;
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        bool work = mStop || mFlushRequested || (configFlag(CONFIG_ENABLE) && !queueEmpty());
+        return work && mWorkerWaiting.exchange(false, std::memory_order_seq_cst);
+      }
+    }
+    return true;
+  }
+
+
+  void out::finalDrain() {
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(mShutdownTimeout);
+    if (!configFlag(CONFIG_ENABLE) || mShutdownTimeout == 0) {
+      return;
+    }
+
+    // Write full batches and flush once at the end
+    mFinalDrain = true;
+    collectThreadBuffers();
+    while (std::chrono::steady_clock::now() < deadline) {
+      size_t count = drain();
+      bool report = reportDrops();
+      if (count == 0 && !report) {
+        break;
+      }
+      writeBatch(count);
+    }
+    mFinalDrain = false;
+
+    std::unique_lock<std::mutex> lock(mSinkMutex);
+    flushSinks(true);
+  }
+
+
+  size_t out::drain() {
+    size_t count = 0;
+    container *c;
+
+    {
+      std::unique_lock<std::mutex> lock(mSinkMutex);
+      updateSinks();
+      // configure() publishes under mSinkMutex, so the whole batch sees one configuration
+      mBatchConfig = mConfig.load(std::memory_order_relaxed);
+
+      // Producers only count their messages, the depth is sampled here where the queue is longest
+      size_t depth = pending();
+      if (depth > mHighWater.load(std::memory_order_relaxed)) {
+        mHighWater.store(depth, std::memory_order_relaxed);
+      }
+
+      // Rotate before rendering, binary records refer to sites written earlier in the same file
+      if ((mRotateRequested || rotationDue()) && logOpen()) {
+        mRotateRequested = false;
+        rotate();
+      }
+    }
+
+    bool ringDrained = false;
+    while (count < DBG_OUT_BATCH_SIZE) {
+      if (!mRing.pop(c)) {
+        ringDrained = true;
+        break;
+      }
+      render(c);
+      ++count;
+    }
+
+    std::vector<container *> merged;
+    std::vector<container *> overflow;
+
+    {
+      std::unique_lock<std::mutex> lock(mQueueMutex);
+      for (auto &batch : mBatches) {
+        merged.insert(merged.end(), batch.begin(), batch.end());
+      }
+      mBatches.clear();
+
+      // Messages which overflowed the ring buffer are newer than everything in it, so they wait until it is empty
+      if (ringDrained) {
+        while (!mMessages.empty() && count + overflow.size() < DBG_OUT_BATCH_SIZE) {
+          overflow.push_back(mMessages.front());
+          mMessages.pop();
+        }
+        if (mMessages.empty()) {
+          mOverflowing.store(false, std::memory_order_relaxed);
+        }
+      }
+    }
+
+    for (auto m : overflow) {
+      render(m);
+    }
+
+    // Batches from different threads are interleaved by timestamp
+    std::stable_sort(merged.begin(), merged.end(), [](const container *lhs, const container *rhs) {
+      return lhs->time < rhs->time;
+    });
+    for (auto m : merged) {
+      render(m);
+    }
+
+    return count + overflow.size() + merged.size();
+  }
+
+
+  void out::render(container *c) {
+    sinkMask sinks = c->sinks & mActiveMask;
+    // The trace sink only receives trace events
+    if (sinks != mActiveTraceMask) {
+      sinks &= ~mActiveTraceMask;
+    }
+    uint32_t config = mBatchConfig;
+    if (!(config & CONFIG_OS)) {
+      sinks &= ~SINK_OS;
+    }
+    if (!(config & CONFIG_OFS)) {
+      sinks &= ~SINK_OFS;
+    }
+
+    if (sinks != 0) {
+      std::string_view body = c->str();
+      if (c->decode != nullptr) {
+        mDecodeBuffer.clear();
+        c->decode(body, mDecodeBuffer);
+        body = mDecodeBuffer.view();
+      }
+
+      uint8_t flags = (c->printTimestamp ? binaryLog::TIMESTAMP : 0) | (c->printLocation ? binaryLog::LOCATION : 0)
+                      | (config & CONFIG_NEWLINE ? binaryLog::NEWLINE : 0);
+      bool binary = mActiveFormat == LOG_FORMAT::BINARY;
+      if (binary && (sinks & SINK_OFS)) {
+        auto encode = [&]() {
+          mRecord.clear();
+          mBinaryWriter.append(
+            mRecord, *c->site, c->time, c->thread, static_cast<uint8_t>(c->verbosity), flags, body);
+        };
+        encode();
+        // A new file starts with an empty site table, the record may have to define its site again
+        if (rotateBefore(mRecord.size())) {
+          encode();
+        }
+        mOFSBuffer += mRecord;
+        sinks &= ~SINK_OFS;
+        ++mBatchMessages[sinkIndex(SINK_OFS)];
+      }
+
+      mLine.clear();
+
+      if (sinks != 0) {
+        appendLine(mLine, *c, body, config & CONFIG_NEWLINE, mTimestampSecond, mTimestampDate);
+      }
+
+      if (sinks & SINK_OS) {
+        mOSBuffer += mLine;
+        ++mBatchMessages[sinkIndex(SINK_OS)];
+      }
+
+      if (sinks & SINK_OFS) {
+        rotateBefore(mLine.size());
+        mOFSBuffer += mLine;
+        ++mBatchMessages[sinkIndex(SINK_OFS)];
+      }
+
+      for (size_t i = 0; i < mActiveSinks.size(); ++i) {
+        if (sinks & mActiveSinks[i].mask) {
+          if (mActiveSinks[i].records) {
+            mActiveSinks[i].target->writeRecord({c->site, c->time, c->thread, c->verbosity, flags, body, mLine});
+            mSinkRecordBytes[i] += mLine.size();
+          }
+          else {
+            mSinkBuffers[i] += mLine;
+          }
+          ++mBatchMessages[sinkIndex(mActiveSinks[i].mask)];
+        }
+      }
+
+      mBatchTimes.push_back(c->time);
+    }
+
+    release(c);
+  }
+
+
+  void out::updateSinks() {
+    if (mSinksChanged) {
+      mActiveSinks = mSinks;
+      mSinkBuffers.resize(mActiveSinks.size());
+      mSinkRecordBytes.assign(mActiveSinks.size(), 0);
+      mActiveMask = SINK_OS | SINK_OFS;
+      for (auto &registered : mActiveSinks) {
+        mActiveMask |= registered.mask;
+      }
+      mActiveTraceMask = mTraceMask.load(std::memory_order_relaxed);
+      mSinksChanged = false;
+    }
+  }
+
+
+  void out::writeBatch(size_t aCount) {
+    {
+      std::unique_lock<std::mutex> lock(mSinkMutex);
+      auto start = std::chrono::steady_clock::now();
+
+      // One write per sink for the whole batch
+      if (!mOSBuffer.empty()) {
+        std::cerr.write(mOSBuffer.data(), static_cast<std::streamsize>(mOSBuffer.size()));
+      }
+      countSink(sinkIndex(SINK_OS), mOSBuffer.size());
+
+      if (!mOFSBuffer.empty()) {
+        writeLog(mOFSBuffer);
+      }
+      countSink(sinkIndex(SINK_OFS), mOFSBuffer.size() + mOFSWritten);
+
+      for (size_t i = 0; i < mActiveSinks.size(); ++i) {
+        if (!mSinkBuffers[i].empty()) {
+          mActiveSinks[i].target->write(mSinkBuffers[i].data(), mSinkBuffers[i].size());
+          mUnflushedBytes += mSinkBuffers[i].size();
+        }
+        mUnflushedBytes += mSinkRecordBytes[i];
+        countSink(sinkIndex(mActiveSinks[i].mask), mSinkBuffers[i].size() + mSinkRecordBytes[i]);
+        mSinkBuffers[i].clear();
+        mSinkRecordBytes[i] = 0;
+      }
+
+      mUnflushedMessages += aCount;
+      mUnflushedBytes += mOSBuffer.size() + mOFSBuffer.size() + mOFSWritten;
+      mOFSWritten = 0;
+      mOSBuffer.clear();
+      mOFSBuffer.clear();
+
+      flushSinks(false);
+
+      mIOTime.fetch_add(static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                                                std::chrono::steady_clock::now() - start)
+                                                .count()),
+                        std::memory_order_relaxed);
+    }
+
+    countLatency();
+    mWritten.fetch_add(aCount, std::memory_order_relaxed);
+    complete(aCount);
+  }
+
+
+  size_t out::pending() const {
+    // Read mCompleted first so that the difference can not underflow. The worker counted a message only after
+    // popping it, which happens after the producer counted it in mEnqueued.
+    uint64_t completed = mCompleted.load(std::memory_order_acquire);
+    return static_cast<size_t>(mEnqueued.load(std::memory_order_acquire) - completed);
+  }
+
+
+  void out::complete(size_t aCount) {
+    if (aCount != 0) {
+      mCompleted.fetch_add(aCount, std::memory_order_release);
+    }
+
+    // Pairs with the fences in makeRoom() and wait(), either they see mCompleted or the worker sees them
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+
+    if (mBlockedProducers.load(std::memory_order_relaxed) != 0) {
+      std::unique_lock<std::mutex> lock(mSpaceMutex);
+      mSpaceCondition.notify_all();
+    }
+
+    // Waiters register before checking mCompleted, so either they see the new value or they are notified.
+    // Notifying under the mutex means a waiter can not miss it between its check and going to sleep.
+    if (mWaiters.load(std::memory_order_relaxed) != 0) {
+      std::unique_lock<std::mutex> lock(mTaskFinishedMutex);
+      mTaskFinishedCondition.notify_all();
+    }
+  }
+
+
+  void out::countSink(size_t aIndex, size_t aBytes) {
+    if (mBatchMessages[aIndex] != 0) {
+      mSinkMessages[aIndex].fetch_add(mBatchMessages[aIndex], std::memory_order_relaxed);
+      mSinkBytes[aIndex].fetch_add(aBytes, std::memory_order_relaxed);
+      mBatchMessages[aIndex] = 0;
+    }
+  }
+
+
+  void out::countLatency() {
+    if (mBatchTimes.empty()) {
+      return;
+    }
+
+    uint64_t buckets[LATENCY_BUCKETS] = {};
+    auto now = std::chrono::system_clock::now();
+    for (auto time : mBatchTimes) {
+      auto microseconds = std::chrono::duration_cast<std::chrono::microseconds>(now - time).count();
+      size_t bucket = 0;
+      while (bucket + 1 < LATENCY_BUCKETS && microseconds >= (int64_t(1) << bucket)) {
+        ++bucket;
+      }
+      ++buckets[bucket];
+    }
+    mBatchTimes.clear();
+
+    for (size_t i = 0; i < LATENCY_BUCKETS; ++i) {
+      if (buckets[i] != 0) {
+        mLatency[i].fetch_add(buckets[i], std::memory_order_relaxed);
+      }
+    }
+  }
+
+
+  bool out::reportDrops() {
+    size_t dropped = mDropped.load(std::memory_order_relaxed);
+    auto now = std::chrono::steady_clock::now();
+
+    if (dropped == mDroppedReported || now - mLastDropReport < std::chrono::milliseconds(DBG_OUT_DROP_REPORT_MS)) {
+      return false;
+    }
+
+    static callSite site(__FILE__, __FUNCTION__, __LINE__);
+    container *c = acquire(configFlag(CONFIG_TIMESTAMP), false, true, true, site, 0);
+    format(c->body, "DBG::out dropped ", dropped - mDroppedReported, " messages");
+    render(c);
+
+    mDroppedReported = dropped;
+    mLastDropReport = now;
+    return true;
+  }
+
+
+  bool out::reportSuppressed() {
+    mSuppressedPending = callSite::takeSuppressedPending() || mSuppressedPending;
+    auto now = std::chrono::steady_clock::now();
+
+    if (!mSuppressedPending
+        || now - mLastSuppressedReport < std::chrono::milliseconds(DBG_OUT_DROP_REPORT_MS)) {
+      return false;
+    }
+
+    bool reported = false;
+    callSite::forEach([&](callSite &site) {
+      uint64_t suppressed = site.takeSuppressed();
+      if (suppressed != 0) {
+        container *c = acquire(configFlag(CONFIG_TIMESTAMP), configFlag(CONFIG_LOCATION), true, true, site, 0);
+        format(c->body, "suppressed ", suppressed, " similar messages");
+        render(c);
+        reported = true;
+      }
+    });
+
+    mSuppressedPending = false;
+    mLastSuppressedReport = now;
+    return reported;
+  }
+
+
+  void out::flushSinks(bool aForce) {
+    if (mFinalDrain && !aForce) {
+      return;
+    }
+
+    bool flush = aForce;
+
+    switch (mFlushPolicy.load()) {
+      case FLUSH_POLICY::ALWAYS:
+        flush = true;
+        break;
+      case FLUSH_POLICY::MESSAGES:
+        flush = flush || mUnflushedMessages >= mFlushThreshold;
+        break;
+      case FLUSH_POLICY::BYTES:
+        flush = flush || mUnflushedBytes >= mFlushThreshold;
+        break;
+      case FLUSH_POLICY::INTERVAL:
+        flush = flush
+                || std::chrono::steady_clock::now() - mLastFlush >= std::chrono::milliseconds(mFlushThreshold);
+        break;
+      case FLUSH_POLICY::MANUAL:
+        break;
+    }
+
+    // Forced flushes (wait(), shutdown and crashes) also wait for the asynchronous writes in flight
+    if (aForce) {
+      mAsyncFile.flush();
+      mAsyncFile.sync();
+    }
+
+    if (!flush || mUnflushedMessages == 0) {
+      return;
+    }
+
+    std::cerr.flush();
+    if (mOFS.is_open()) {
+      mOFS.flush();
+    }
+    mMappedFile.flush();
+    mAsyncFile.flush();
+    for (auto &registered : mActiveSinks) {
+      registered.target->flush();
+    }
+
+    mUnflushedMessages = 0;
+    mUnflushedBytes = 0;
+    mLastFlush = std::chrono::steady_clock::now();
+  }
+
+
+  void out::wait() {
+    collectThreadBuffers();
+
+    // Only messages accepted before this call are waited for
+    uint64_t target = mEnqueued.load(std::memory_order_relaxed);
+
+    if (mCompleted.load(std::memory_order_acquire) < target) {
+      mWaiters.fetch_add(1, std::memory_order_relaxed);
+      std::atomic_thread_fence(std::memory_order_seq_cst);
+      {
+        std::unique_lock<std::mutex> lock(mTaskFinishedMutex);
+        mTaskFinishedCondition.wait(lock, [this, target]() {
+          return mCompleted.load(std::memory_order_acquire) >= target;
+        });
+      }
+      mWaiters.fetch_sub(1, std::memory_order_relaxed);
+    }
+
+    std::unique_lock<std::mutex> lock(mSinkMutex);
+    flushSinks(true);
+  }
+
+
+  size_t out::remainingMessages() {
+    return pending();
+  }
+
+
+  out::metrics out::getMetrics() {
+    metrics m;
+    m.written = mWritten.load(std::memory_order_relaxed);
+    m.queueDepth = pending();
+    m.enqueued = mEnqueued.load(std::memory_order_relaxed);
+    m.dropped = mDropped.load(std::memory_order_relaxed);
+    m.queueHighWater = mHighWater.load(std::memory_order_relaxed);
+    m.formatNanoseconds = mFormatTime.load(std::memory_order_relaxed);
+    m.ioNanoseconds = mIOTime.load(std::memory_order_relaxed);
+    for (size_t i = 0; i < LATENCY_BUCKETS; ++i) {
+      m.latency[i] = mLatency[i].load(std::memory_order_relaxed);
+    }
+
+    auto sinkEntry = [this](sinkMask aMask, size_t aDropped) {
+      size_t index = sinkIndex(aMask);
+      return sinkMetrics{aMask,
+                         mSinkMessages[index].load(std::memory_order_relaxed),
+                         mSinkBytes[index].load(std::memory_order_relaxed),
+                         aDropped};
+    };
+
+    m.sinks.push_back(sinkEntry(SINK_OS, 0));
+    m.sinks.push_back(sinkEntry(SINK_OFS, 0));
+
+    // Not mSinkMutex, the worker holds it while a sink blocks
+    std::unique_lock<std::mutex> lock(mSinkListMutex);
+    for (auto &registered : mSinks) {
+      m.sinks.push_back(sinkEntry(registered.mask, registered.target->dropped()));
+    }
+    return m;
+  }
+
+
+  out::QUEUE_MODE out::queueMode() {
+    return static_cast<QUEUE_MODE>((mConfig.load(std::memory_order_relaxed) & CONFIG_QUEUE_MODE)
+                                   >> CONFIG_QUEUE_MODE_SHIFT);
+  }
+
+
+  void out::queueCapacity(size_t aCapacity, OVERFLOW_POLICY aPolicy, uint8_t aDropVerbosity) {
+    mOverflowPolicy = aPolicy;
+    mDropVerbosity = aDropVerbosity;
+    mCapacity = aCapacity;
+
+    // Blocked producers may now fit
+    std::unique_lock<std::mutex> lock(mSpaceMutex);
+    mSpaceCondition.notify_all();
+  }
+
+
+  size_t out::droppedMessages() {
+    return mDropped;
+  }
+
+
+  void out::queueMode(QUEUE_MODE aMode) {
+    if (aMode != QUEUE_MODE::FLIGHT_RECORDER && configFlag(CONFIG_ENABLE)) {
+      startWorker();
+    }
+
+    uint32_t previous = setConfig(CONFIG_QUEUE_MODE, static_cast<uint32_t>(aMode) << CONFIG_QUEUE_MODE_SHIFT);
+    bool wasThreadLocal
+      = (previous & CONFIG_QUEUE_MODE) >> CONFIG_QUEUE_MODE_SHIFT == static_cast<uint32_t>(QUEUE_MODE::THREAD_LOCAL);
+    if (wasThreadLocal && aMode != QUEUE_MODE::THREAD_LOCAL) {
+      collectThreadBuffers();
+    }
+    else if (!wasThreadLocal && aMode == QUEUE_MODE::THREAD_LOCAL) {
+      // A worker which went to sleep without the collection timer would not see partially filled buffers.
+      // Notified under the mutex, so it can not be missed between the worker's check and going to sleep.
+      std::unique_lock<std::mutex> lock(mQueueMutex);
+      notifyWorker();
+    }
+  }
+
+
+  void out::appendLine(std::string &aLine,
+                       const container &c,
+                       std::string_view aBody,
+                       bool aNewline,
+                       time_t &_second,
+                       std::string &_date) {
+    if (c.printTimestamp == true) {
+      appendTimestamp(aLine, c.time, _second, _date);
+      aLine += " - ";
+    }
+
+    if (c.printLocation == true) {
+      aLine += c.site->file;
+      aLine += ":";
+      aLine += c.site->function;
+      aLine += ":" + std::to_string(c.site->line) + "\t - ";
+    }
+
+    aLine += aBody;
+
+    if (aNewline) {
+      aLine += "\n";
+    }
+  }
+
+
+  void out::appendTimestamp(std::string &aOutput,
+                            std::chrono::system_clock::time_point time,
+                            time_t &_second,
+                            std::string &_date) {
+    auto second = std::chrono::floor<std::chrono::seconds>(time);
+    time_t rawtime = std::chrono::system_clock::to_time_t(second);
+
+    // localtime_r and strftime only run once per second, the rest of the second is formatted per message
+    if (rawtime != _second || _date.empty()) {
+      struct tm timeinfo;
+      localtime_r(&rawtime, &timeinfo);
+      char buffer[80];
+      size_t length = strftime(buffer, 80, "%h %d, %Y %H:%M:%S.", &timeinfo);
+      _date.assign(buffer, length);
+      _second = rawtime;
+    }
+
+    aOutput += _date;
+    char digits[8];
+    auto microseconds = std::chrono::duration_cast<std::chrono::microseconds>(time - second).count();
+    size_t length = static_cast<size_t>(std::to_chars(digits, digits + sizeof(digits), microseconds).ptr - digits);
+    aOutput.append(6 - length, '0');
+    aOutput.append(digits, length);
   }
 }  // namespace DBG
@@ -13,17 +13,70 @@
 #define DBG_OUT_HPP
 
 #include <cstdint>  // uint8_t
+#include <ctime>    // time_t
 
 #include <atomic>              // std::atomic
 #include <chrono>              // std::chrono::system_clock::time_point
 #include <condition_variable>  // std::condition_variable
 #include <fstream>             // std::ofstream
+#include <memory>              // std::shared_ptr, std::unique_ptr
 #include <mutex>               // std::mutex, std::unique_lock
 #include <queue>               // std::queue
-#include <sstream>             // std::stringstream
 #include <string>              // std::string
+#include <string_view>         // std::string_view
 #include <thread>              // std::thread
 #include <utility>             // std::forward
+#include <vector>              // std::vector
+
+#include "DBG_asyncFile.hpp"
+#include "DBG_binaryLog.hpp"
+#include "DBG_callSite.hpp"
+#include "DBG_compressor.hpp"
+#include "DBG_configWatcher.hpp"
+#include "DBG_format.hpp"
+#include "DBG_mappedFile.hpp"
+#include "DBG_ringBuffer.hpp"
+#include "DBG_sink.hpp"
+#include "DBG_workerPool.hpp"
+
+#ifndef DBG_OUT_QUEUE_CAPACITY
+  #define DBG_OUT_QUEUE_CAPACITY 4096
+#endif
+
+// Messages pooled for reuse, messages beyond this are allocated on demand
+#ifndef DBG_OUT_POOL_SIZE
+  #define DBG_OUT_POOL_SIZE DBG_OUT_QUEUE_CAPACITY
+#endif
+
+// Messages the worker writes per batch
+#ifndef DBG_OUT_BATCH_SIZE
+  #define DBG_OUT_BATCH_SIZE 1024
+#endif
+
+// Minimum interval between reports of dropped messages
+#ifndef DBG_OUT_DROP_REPORT_MS
+  #define DBG_OUT_DROP_REPORT_MS 1000
+#endif
+
+// Messages kept by QUEUE_MODE::FLIGHT_RECORDER
+#ifndef DBG_OUT_FLIGHT_RECORDER_SIZE
+  #define DBG_OUT_FLIGHT_RECORDER_SIZE 1024
+#endif
+
+// Time shutdown() and the destructor spend writing queued messages
+#ifndef DBG_OUT_SHUTDOWN_TIMEOUT_MS
+  #define DBG_OUT_SHUTDOWN_TIMEOUT_MS 2000
+#endif
+
+// Messages a thread buffers before handing them to the worker
+#ifndef DBG_OUT_THREAD_BUFFER_SIZE
+  #define DBG_OUT_THREAD_BUFFER_SIZE 64
+#endif
+
+// Interval at which the worker collects partially filled thread buffers
+#ifndef DBG_OUT_THREAD_BUFFER_FLUSH_MS
+  #define DBG_OUT_THREAD_BUFFER_FLUSH_MS 100
+#endif
 
 #if __has_include(<source_location>)
   #include <source_location>
@@ -32,6 +85,9 @@
     #define DBG_OUT_current_location_get       std::source_location::current()
     #define DBG_OUT_current_location_parameter const std::source_location &location
     #define DBG_OUT_current_location_usage     location.line(), location.file_name(), location.function_name()
+    #define DBG_OUT_current_site_get                                                                      \
+      std::source_location::current().file_name(), std::source_location::current().function_name(), \
+        std::source_location::current().line()
   #endif
 #elif __has_include(<experimental/source_location>)
   #include <experimental/source_location>
@@ -40,6 +96,10 @@
     #define DBG_OUT_current_location_get       std::experimental::source_location::current()
     #define DBG_OUT_current_location_parameter const std::experimental::source_location &location
     #define DBG_OUT_current_location_usage     location.line(), location.file_name(), location.function_name()
+    #define DBG_OUT_current_site_get                                                          \
+      std::experimental::source_location::current().file_name(),                              \
+        std::experimental::source_location::current().function_name(),                         \
+        std::experimental::source_location::current().line()
   #endif
 #endif
 
@@ -48,22 +108,78 @@
   #define DBG_OUT_current_location_get       __LINE__, __FILE__, __FUNCTION__
   #define DBG_OUT_current_location_parameter const int &line, const std::string &file, const std::string &function
   #define DBG_OUT_current_location_usage     line, file, function
+  #define DBG_OUT_current_site_get           __FILE__, __FUNCTION__, __LINE__
 #endif
 
+// Messages with a verbosity above DBG_OUT_MAX_VERBOSITY are removed at compile time.
+// Defining it keeps the print macros enabled when NDEBUG is defined.
 #ifndef DBG_OUT_PRINT_MACROS
   #define DBG_OUT_PRINT_MACROS
-  #ifndef NDEBUG
-    #define DBG_print(...)  DBG::out::instance().print(DBG_OUT_current_location_get, 0, __VA_ARGS__)
-    #define DBG_printf(...) DBG::out::instance().printf(DBG_OUT_current_location_get, 0, __VA_ARGS__)
+  #if !defined(NDEBUG) || defined(DBG_OUT_MAX_VERBOSITY)
+    #ifndef DBG_OUT_MAX_VERBOSITY
+      #define DBG_OUT_MAX_VERBOSITY 255
+    #endif
+    // The verbosity check happens before the arguments are evaluated, so filtered messages cost one atomic load.
+    // For a constant verbosity above DBG_OUT_MAX_VERBOSITY the condition is a constant false and the call is removed.
+    // Every expansion owns a constant-initialized DBG::callSite, only a pointer to it is queued with the message.
+    // logger and verbosity are any expressions yielding a DBG::out & and a verbosity, each is evaluated once.
+    // The macros are statements (do { } while (0)) and, unlike the member function calls they used to expand to,
+    // can not be used as expressions.
+    #define DBG_OUT_print_to(logger, verbosity, method, ...)                                            \
+      do {                                                                                             \
+        DBG::out &DBG_OUT_logger = (logger);                                                           \
+        const size_t DBG_OUT_verbosity = (verbosity);                                                  \
+        if (DBG_OUT_verbosity <= DBG_OUT_MAX_VERBOSITY && DBG_OUT_logger.accepts(DBG_OUT_verbosity)) { \
+          static DBG::callSite DBG_OUT_site(DBG_OUT_current_site_get);                                 \
+          if (DBG_OUT_site.enabled()) {                                                                \
+            DBG_OUT_logger.method(DBG_OUT_site, __VA_ARGS__);                                          \
+          }                                                                                            \
+        }                                                                                              \
+      } while (0)
+    #define DBG_OUT_print_if(verbosity, method, ...) \
+      DBG_OUT_print_to(DBG::out::instance(), verbosity, method, __VA_ARGS__)
+    // Same as DBG_OUT_print_if, logging only when the site's rate limit passes.
+    // The worker periodically logs how many calls each limited site suppressed.
+    #define DBG_OUT_print_limited(verbosity, limit, method, ...)                                                 \
+      do {                                                                                                      \
+        const size_t DBG_OUT_verbosity = (verbosity);                                                           \
+        if (DBG_OUT_verbosity <= DBG_OUT_MAX_VERBOSITY && DBG::out::instance().accepts(DBG_OUT_verbosity)) { \
+          static DBG::callSite DBG_OUT_site(DBG_OUT_current_site_get);                                          \
+          if (DBG_OUT_site.enabled() && DBG_OUT_site.limit) {                                                   \
+            DBG::out::instance().method(DBG_OUT_site, __VA_ARGS__);                                             \
+          }                                                                                                     \
+        }                                                                                                       \
+      } while (0)
+    // The v variants pass DBG_OUT_verbosity to the method, the value the check has already evaluated
+    #define DBG_print(...)  DBG_OUT_print_if(0, print, 0, __VA_ARGS__)
+    #define DBG_printf(...) DBG_OUT_print_if(0, printf, 0, __VA_ARGS__)
     #define DBG_write(_printTimestamp, _printLocation, _os, _ofs, ...) \
-      DBG::out::instance().write(                                      \
-        DBG_OUT_current_location_get, _printTimestamp, _printLocation, _os, _ofs, 0, __VA_ARGS__)
-    #define DBG_printv(verbosity, ...) DBG::out::instance().print(DBG_OUT_current_location_get, verbosity, __VA_ARGS__)
-    #define DBG_printvf(verbosity, ...) \
-      DBG::out::instance().printf(DBG_OUT_current_location_get, verbosity, __VA_ARGS__)
+      DBG_OUT_print_if(0, write, _printTimestamp, _printLocation, _os, _ofs, 0, __VA_ARGS__)
+    #define DBG_printv(verbosity, ...)  DBG_OUT_print_if(verbosity, print, DBG_OUT_verbosity, __VA_ARGS__)
+    #define DBG_printvf(verbosity, ...) DBG_OUT_print_if(verbosity, printf, DBG_OUT_verbosity, __VA_ARGS__)
     #define DBG_writev(verbosity, _printTimestamp, _printLocation, _os, _ofs, ...) \
-      DBG::out::instance().write(                                                  \
-        DBG_OUT_current_location_get, _printTimestamp, _printLocation, _os, _ofs, verbosity, __VA_ARGS__)
+      DBG_OUT_print_if(verbosity, write, _printTimestamp, _printLocation, _os, _ofs, DBG_OUT_verbosity, __VA_ARGS__)
+    #define DBG_print_every_n(n, ...)          DBG_OUT_print_limited(0, every(n), print, 0, __VA_ARGS__)
+    #define DBG_print_rate(perSecond, ...)     DBG_OUT_print_limited(0, rate(perSecond), print, 0, __VA_ARGS__)
+    #define DBG_print_once(...)                DBG_OUT_print_limited(0, once(), print, 0, __VA_ARGS__)
+    #define DBG_printv_every_n(verbosity, n, ...) \
+      DBG_OUT_print_limited(verbosity, every(n), print, DBG_OUT_verbosity, __VA_ARGS__)
+    #define DBG_printv_rate(verbosity, perSecond, ...) \
+      DBG_OUT_print_limited(verbosity, rate(perSecond), print, DBG_OUT_verbosity, __VA_ARGS__)
+    #define DBG_printv_once(verbosity, ...) \
+      DBG_OUT_print_limited(verbosity, once(), print, DBG_OUT_verbosity, __VA_ARGS__)
+    // Same as the macros above for a logger other than DBG::out::instance(), see DBG::out::instance(name)
+    #define DBG_print_to(logger, ...)  DBG_OUT_print_to(logger, 0, print, 0, __VA_ARGS__)
+    #define DBG_printf_to(logger, ...) DBG_OUT_print_to(logger, 0, printf, 0, __VA_ARGS__)
+    #define DBG_write_to(logger, _printTimestamp, _printLocation, _os, _ofs, ...) \
+      DBG_OUT_print_to(logger, 0, write, _printTimestamp, _printLocation, _os, _ofs, 0, __VA_ARGS__)
+    #define DBG_printv_to(logger, verbosity, ...) \
+      DBG_OUT_print_to(logger, verbosity, print, DBG_OUT_verbosity, __VA_ARGS__)
+    #define DBG_printvf_to(logger, verbosity, ...) \
+      DBG_OUT_print_to(logger, verbosity, printf, DBG_OUT_verbosity, __VA_ARGS__)
+    #define DBG_writev_to(logger, verbosity, _printTimestamp, _printLocation, _os, _ofs, ...) \
+      DBG_OUT_print_to(                                                                   \
+        logger, verbosity, write, _printTimestamp, _printLocation, _os, _ofs, DBG_OUT_verbosity, __VA_ARGS__)
   #else
     #define DBG_print(...)
     #define DBG_printf(...)
@@ -71,6 +187,18 @@
     #define DBG_printv(verbosity, ...)
     #define DBG_printvf(verbosity, ...)
     #define DBG_writev(verbosity, _printTimestamp, _printLocation, _os, _ofs, ...)
+    #define DBG_print_every_n(n, ...)
+    #define DBG_print_rate(perSecond, ...)
+    #define DBG_print_once(...)
+    #define DBG_printv_every_n(verbosity, n, ...)
+    #define DBG_printv_rate(verbosity, perSecond, ...)
+    #define DBG_printv_once(verbosity, ...)
+    #define DBG_print_to(logger, ...)
+    #define DBG_printf_to(logger, ...)
+    #define DBG_write_to(logger, _printTimestamp, _printLocation, _os, _ofs, ...)
+    #define DBG_printv_to(logger, verbosity, ...)
+    #define DBG_printvf_to(logger, verbosity, ...)
+    #define DBG_writev_to(logger, verbosity, _printTimestamp, _printLocation, _os, _ofs, ...)
   #endif
 #endif
 
@@ -78,21 +206,101 @@
 namespace DBG {
   class out {
   public:
-    out();
+    enum class QUEUE_MODE {
+      LOCK_FREE,     // Bounded lock-free ring buffer, overflow goes to the mutex queue
+      MUTEX,         // std::queue protected by mQueueMutex
+      THREAD_LOCAL,  // Per-thread buffers handed to the worker in batches
+      FLIGHT_RECORDER  // Overwrites the oldest of the last DBG_OUT_FLIGHT_RECORDER_SIZE messages, written by dump()
+    };
+
+    enum class FLUSH_POLICY {
+      ALWAYS,    // Flush after every write
+      MESSAGES,  // Flush once threshold messages have been written
+      BYTES,     // Flush once threshold bytes have been written
+      INTERVAL,  // Flush at most every threshold milliseconds
+      MANUAL     // Only flush on wait() and shutdown
+    };
+
+    enum class FILE_MODE {
+      STREAM,  // std::ofstream
+      MMAP,    // Preallocated file written through mmap, see DBG::mappedFile
+      AIO      // Several buffers written by POSIX AIO while the next batch is formatted, see DBG::asyncFile
+    };
+
+    enum class OVERFLOW_POLICY {
+      BLOCK,        // Wait until the worker has made room
+      DROP_NEWEST,  // Discard the message being logged
+      DROP_OLDEST,  // Discard the oldest queued message, or the message being logged if none is queued
+      DROP_VERBOSE  // Discard the message if its verbosity is at least the drop verbosity
+    };
+
+    enum class LOG_FORMAT {
+      TEXT,   // Same lines as std::cerr
+      BINARY  // Compact records, see DBG_binaryLog.hpp and DBG_decode.cpp
+    };
+
+    // Enqueue-to-write latency histogram, bucket i counts messages written within 2^i microseconds
+    // of being logged and the last bucket counts everything slower
+    static constexpr size_t LATENCY_BUCKETS = 24;
+
+    struct sinkMetrics {
+      sinkMask sink;      // SINK_OS, SINK_OFS or a bit returned by addSink()
+      uint64_t messages;  // Messages written
+      uint64_t bytes;     // Bytes written
+      uint64_t dropped;   // Bytes the sink discarded, see sink::dropped()
+    };
+
+    struct metrics {
+      uint64_t enqueued;           // Messages accepted by enqueue(), thread buffers count once they are handed off
+      uint64_t written;            // Messages the worker has written
+      uint64_t dropped;            // Messages discarded by the overflow policy
+      size_t queueDepth;           // Messages waiting to be written
+      size_t queueHighWater;       // Largest queueDepth seen by the worker at the start of a batch
+      uint64_t formatNanoseconds;  // Worker time spent rendering messages
+      uint64_t ioNanoseconds;      // Worker time spent writing to sinks
+      uint64_t latency[LATENCY_BUCKETS];
+      std::vector<sinkMetrics> sinks;  // std::cerr, the log file, then every registered sink
+    };
+
+    // aName identifies the logger in its default log file name, see instance(name).
+    // With aPool the logger is drained by the pool's threads instead of a worker of its own.
+    explicit out(const std::string &aName = std::string(), std::shared_ptr<workerPool> aPool = nullptr);
     ~out();
 
+    out(const out &) = delete;
+    out &operator=(const out &) = delete;
+
+    // Default logger, used by the DBG_print family of macros
     static out &instance() {
-      static out o;
+      static out o(std::string(), nullptr, true);
       return o;
     }
 
-    // Enable/Disable
+    // Logger named aName, created on first use and kept until exit. It has its own queue, worker,
+    // configuration, log file and sinks, log to it with the DBG_print_to family of macros.
+    // An empty name returns instance(). aPool is only used when the logger is created.
+    static out &instance(const std::string &aName, std::shared_ptr<workerPool> aPool = nullptr);
+
+    const std::string &name() const;
+
+    // Enable/Disable, the worker thread is started when the logger is first enabled
     bool enabled();
     void enable(const bool &aEnable = true);
     void disable();
 
+    // Stops the worker once it has written the queued messages or the shutdown timeout has passed.
+    // Messages still queued after that are discarded and counted as dropped.
     void shutdown();
 
+    // Time shutdown() and the destructor spend writing queued messages, 0 discards them immediately
+    void shutdownTimeout(size_t aMilliseconds);
+
+    // Installs handlers for SIGSEGV, SIGBUS, SIGFPE, SIGILL, SIGABRT and std::terminate which give the worker
+    // up to the shutdown timeout to write and flush the queued messages, then continue with the default action.
+    // This is best effort: the handlers are not async-signal-safe, and messages still in thread buffers are lost.
+    // In FLIGHT_RECORDER mode they dump() the recorder instead. Each logger opts in separately, up to 16 loggers.
+    void flushOnCrash(bool aEnable = true);
+
     // Enable/Disable
     bool osEnabled();
     void osEnable(const bool &aEnable = true);
@@ -100,70 +308,202 @@ namespace DBG {
 
     // Add modifier to end of output
     void flush(bool aFlush);
+    void flush(FLUSH_POLICY aPolicy, size_t aThreshold = 0);
     void newline(bool aNewline);
 
+    // Capture raw arguments and format them on the worker thread.
+    // Messages with arguments that can not be captured are still formatted by the caller.
+    bool deferredFormatting();
+    void deferredFormatting(bool aDeferred);
+
     // Enable/disable OFS
     bool ofsEnabled();
     void ofsEnable(const bool &aEnable = true);
     void ofsDisable();
 
+    // Log file backend, returns false if aMode could not be opened.
+    // MMAP switches to STREAM when the file can not be grown any further.
+    FILE_MODE fileMode();
+    bool fileMode(FILE_MODE aMode);
+
     uint8_t verbosity();
     void verbosity(uint8_t aVerbosity);
 
-    // Log file modification
+    // Returns true if a message of the given verbosity would currently be output
+    bool accepts(size_t aVerbosity) const {
+      uint32_t config = mConfig.load(std::memory_order_relaxed);
+      return (config & (CONFIG_ENABLE | CONFIG_DISABLE)) == CONFIG_ENABLE
+             && aVerbosity <= (config & CONFIG_VERBOSITY) >> CONFIG_VERBOSITY_SHIFT;
+    }
+
+    // Log file modification. Nothing touches the disk until the log file is first enabled with ofsEnable(),
+    // the directory and name can only be changed before then. getLogFilename() is empty until the file is open.
     std::string getLogFilename();
 
+    // Directory of the log files, defaults to ./logs and is created if necessary
+    bool logDirectory(const std::string &aDirectory);
+
+    // Log file name without the extension, defaults to "Debug Log <unix time>", or "<name> Log <unix time>".
+    // Files which already exist are not reused, " (n)" is added to the name instead.
+    bool logFilename(const std::string &aFilename);
+
+    // Start a new log file once the current one reaches aBytes or is aSeconds old, 0 disables the limit
+    void rotateSize(size_t aBytes);
+    void rotateInterval(size_t aSeconds);
+
+    // Format of the log file, changing it starts a new file (.log or .dbg)
+    LOG_FORMAT logFormat();
+    void logFormat(LOG_FORMAT aFormat);
+
+    // Gzip rotated log files on a background thread. Needs zlib, see DBG_compressor.hpp.
+    void compressRotated(bool aCompress);
+
+    // Complete configuration of a logger, see configuration() and configure()
+    struct settings {
+      bool enabled;
+      bool os;
+      bool ofs;
+      bool timestamp;
+      bool location;
+      bool newline;
+      bool deferred;
+      uint8_t verbosity;
+      FLUSH_POLICY flushPolicy;
+      size_t flushThreshold;
+      size_t rotateSize;
+      size_t rotateInterval;
+      LOG_FORMAT logFormat;
+      FILE_MODE fileMode;
+      std::string logDirectory;  // Changing it while the log file is open starts a new file in the new directory
+    };
+
+    // Consistent copy of the current configuration
+    settings configuration();
+
+    // Applies every field at once. Producers switch with a single store of the packed configuration word and
+    // the worker picks up the change at the start of its next batch, so neither sees a mix of old and new values.
+    // Returns false if the file mode or the log file could not be opened, everything else is still applied.
+    bool configure(const settings &aSettings);
+
+    // Applies "key=value" pairs separated by whitespace, ',' or ';' on top of the current configuration,
+    // '#' starts a comment. A value in double quotes may contain separators and '#', but not '"'.
+    // Nothing is applied if a key or value is not recognized.
+    //   enable, os, ofs, timestamp, location, newline, deferred  0, 1, true, false, on or off
+    //   verbosity                                                0 to 255
+    //   flush                                                    always, manual, messages, bytes or interval
+    //   flush_threshold, rotate_size, rotate_interval            unsigned integer
+    //   format                                                   text or binary
+    //   file_mode                                                stream, mmap or aio
+    //   directory                                                path, in double quotes if it contains separators
+    bool configure(const std::string &aText);
+
+    // configure() with the value of the environment variable aVariable, false if it is not set
+    bool configureFromEnvironment(const char *aVariable = "DBG_OUT_CONFIG");
+
+    // configure() with the contents of aPath
+    bool configureFromFile(const std::string &aPath);
+
+    // Applies aPath now and whenever it changes, checked every aMilliseconds from a background thread.
+    // An empty path stops watching.
+    void watchConfig(const std::string &aPath, size_t aMilliseconds = 1000);
+
+    // Additional outputs. A registered sink receives every message which is sent to std::cerr or the log file,
+    // wrap it in an asyncSink to give it its own thread, or use a networkSink to ship it to a collector.
+    // std::cerr and the log file are written by the worker itself. To keep a slow terminal off the worker,
+    // osDisable() and add an asyncSink around a streamSink(std::cerr) instead.
+    // Returns the sink's bit, or 0 if all bits are in use.
+    sinkMask addSink(std::shared_ptr<sink> aSink);
+    void removeSink(sinkMask aSink);
+
+    // Sends DBG_scope records to aSink as Chrome trace events (chrome://tracing, Perfetto) instead of text lines.
+    // The sink receives nothing else, the closing "]" is optional in that format and is never written.
+    // Replaces any previous trace sink, returns the sink's bit like addSink(). removeSink() restores text output.
+    // Returns 0 and leaves the sinks as they were if every bit is taken.
+    sinkMask traceSink(std::shared_ptr<sink> aSink);
+
+    // Records a finished DBG_scope, aStart and aEnd are tscClock ticks. Converted to time on the worker.
+    void trace(callSite &site, size_t verbosity, const char *aName, uint64_t aStart, uint64_t aEnd);
+
     // Queue status
     void wait();
     size_t remainingMessages();
 
+    // Counters since construction. They are read without locks, only the list of registered sinks takes
+    // mSinkListMutex. A sink that blocks does not hold up the caller.
+    metrics getMetrics();
+
+    // Limits the messages waiting to be written, 0 is unbounded (the default).
+    // In THREAD_LOCAL mode messages still in a thread's buffer do not count against the limit.
+    // Dropped messages are counted and periodically reported in the log.
+    void queueCapacity(size_t aCapacity,
+                       OVERFLOW_POLICY aPolicy = OVERFLOW_POLICY::BLOCK,
+                       uint8_t aDropVerbosity = 1);
+    size_t droppedMessages();
+
+    // Queue transport, may be changed at any time.
+    // FLIGHT_RECORDER performs no I/O and does not need the worker, the messages are only written by dump().
+    QUEUE_MODE queueMode();
+    void queueMode(QUEUE_MODE aMode);
+
+    // Writes the flight recorder oldest first, to the log file if it is open as text and otherwise std::cerr.
+    // The recorder is empty afterwards. Called by the crash handlers in FLIGHT_RECORDER mode, see flushOnCrash().
+    // Returns the number of messages written.
+    size_t dump();
+
     // Print Message:
-    //   Timestamp = mDefaultTimestamp
-    //   Location  = mDefaultLocation
+    //   Timestamp = CONFIG_TIMESTAMP
+    //   Location  = CONFIG_LOCATION
     //   std::cerr = true
     //   ofs       = true (if open)
     template <typename Arg, typename... Args>
-    void print(DBG_OUT_current_location_parameter, size_t verbosity, Arg &&arg, Args &&... args) {
-      if (mDisable) {
+    void print(callSite &site, size_t verbosity, Arg &&arg, Args &&... args) {
+      if (!accepts(verbosity)) {
         return;
       }
 
-      std::stringstream ss;
-
-      ss << std::forward<Arg>(arg);
-      ((ss << std::forward<Args>(args)), ...);
+      uint32_t config = mConfig.load(std::memory_order_relaxed);
+      container *c
+        = acquire(config & CONFIG_TIMESTAMP, config & CONFIG_LOCATION, true, true, site, verbosity);
+      store(c, std::forward<Arg>(arg), std::forward<Args>(args)...);
+      enqueue(c);
+    }
 
-      {
-        std::unique_lock<std::mutex> lock(mQueueMutex);
-        mMessages.push(new container(
-          ss.str(), mDefaultTimestamp, mDefaultLocation, true, true, DBG_OUT_current_location_usage, verbosity));
+    template <typename Arg, typename... Args>
+    void print(DBG_OUT_current_location_parameter, size_t verbosity, Arg &&arg, Args &&... args) {
+      if (accepts(verbosity)) {
+        callSite &site = locationSite(DBG_OUT_current_location_usage);
+        if (site.enabled()) {
+          print(site, verbosity, std::forward<Arg>(arg), std::forward<Args>(args)...);
+        }
       }
-
-      mQueueUpdatedCondition.notify_one();
     }
 
     // Print Message:
-    //   Timestamp = mDefaultTimestamp
-    //   Location  = mDefaultLocation
+    //   Timestamp = CONFIG_TIMESTAMP
+    //   Location  = CONFIG_LOCATION
     //   std::cerr = false (if ofs is not open)
     //   ofs       = true (if open)
     template <typename Arg, typename... Args>
-    void printf(DBG_OUT_current_location_parameter, size_t verbosity, Arg &&arg, Args &&... args) {
-      if (mDisable) {
+    void printf(callSite &site, size_t verbosity, Arg &&arg, Args &&... args) {
+      if (!accepts(verbosity)) {
         return;
       }
 
-      std::stringstream ss;
-      ss << std::forward<Arg>(arg);
-      ((ss << std::forward<Args>(args)), ...);
+      uint32_t config = mConfig.load(std::memory_order_relaxed);
+      container *c
+        = acquire(config & CONFIG_TIMESTAMP, config & CONFIG_LOCATION, false, true, site, verbosity);
+      store(c, std::forward<Arg>(arg), std::forward<Args>(args)...);
+      enqueue(c);
+    }
 
-      {
-        std::unique_lock<std::mutex> lock1(mQueueMutex);
-        mMessages.push(new container(
-          ss.str(), mDefaultTimestamp, mDefaultLocation, false, true, DBG_OUT_current_location_usage, verbosity));
+    template <typename Arg, typename... Args>
+    void printf(DBG_OUT_current_location_parameter, size_t verbosity, Arg &&arg, Args &&... args) {
+      if (accepts(verbosity)) {
+        callSite &site = locationSite(DBG_OUT_current_location_usage);
+        if (site.enabled()) {
+          printf(site, verbosity, std::forward<Arg>(arg), std::forward<Args>(args)...);
+        }
       }
-
-      mQueueUpdatedCondition.notify_one();
     }
 
 
@@ -173,7 +513,7 @@ namespace DBG {
     //   std::cerr = user_defined (defaults to true if ofs is closed)
     //   ofs       = user_defined (if ofs is open)
     template <typename Arg, typename... Args>
-    void write(DBG_OUT_current_location_parameter,
+    void write(callSite &site,
                const bool _printTimestamp,
                const bool _printLocation,
                const bool _os,
@@ -181,79 +521,421 @@ namespace DBG {
                size_t verbosity,
                Arg &&arg,
                Args &&... args) {
-      if (mDisable) {
+      if (!accepts(verbosity)) {
         return;
       }
 
-      std::stringstream ss;
-      ss << std::forward<Arg>(arg);
-      ((ss << std::forward<Args>(args)), ...);
+      container *c = acquire(_printTimestamp, _printLocation, _os, _ofs, site, verbosity);
+      store(c, std::forward<Arg>(arg), std::forward<Args>(args)...);
+      enqueue(c);
+    }
 
-      {
-        std::unique_lock<std::mutex> lock(mQueueMutex);
-        mMessages.push(new container(
-          ss.str(), _printTimestamp, _printLocation, _os, _ofs, DBG_OUT_current_location_usage, verbosity));
+    template <typename Arg, typename... Args>
+    void write(DBG_OUT_current_location_parameter,
+               const bool _printTimestamp,
+               const bool _printLocation,
+               const bool _os,
+               const bool _ofs,
+               size_t verbosity,
+               Arg &&arg,
+               Args &&... args) {
+      if (accepts(verbosity)) {
+        callSite &site = locationSite(DBG_OUT_current_location_usage);
+        if (site.enabled()) {
+          write(site,
+                _printTimestamp,
+                _printLocation,
+                _os,
+                _ofs,
+                verbosity,
+                std::forward<Arg>(arg),
+                std::forward<Args>(args)...);
+        }
       }
-
-      mQueueUpdatedCondition.notify_one();
     }
 
+    // Enables or disables every registered call site in a file whose path ends with aFile.
+    // aLine of 0 matches every line. Sites register the first time they log. Returns the number of sites changed.
+    size_t callSiteEnable(const std::string &aFile, int aLine, bool aEnable = true);
+
 
   private:
+    friend class workerPool;
+
+    // aDefault is only set for instance()
+    out(const std::string &aName, std::shared_ptr<workerPool> aPool, bool aDefault);
+
+    // Bits of mConfig
+    static constexpr uint32_t CONFIG_ENABLE = 1u << 0;
+    static constexpr uint32_t CONFIG_DISABLE = 1u << 1;  // Set by shutdown(), can not be cleared
+    static constexpr uint32_t CONFIG_OS = 1u << 2;
+    static constexpr uint32_t CONFIG_OFS = 1u << 3;
+    static constexpr uint32_t CONFIG_TIMESTAMP = 1u << 4;
+    static constexpr uint32_t CONFIG_LOCATION = 1u << 5;
+    static constexpr uint32_t CONFIG_NEWLINE = 1u << 6;
+    static constexpr uint32_t CONFIG_DEFERRED = 1u << 7;
+    static constexpr uint32_t CONFIG_VERBOSITY_SHIFT = 8;
+    static constexpr uint32_t CONFIG_VERBOSITY = 0xFFu << CONFIG_VERBOSITY_SHIFT;
+    static constexpr uint32_t CONFIG_QUEUE_MODE_SHIFT = 16;
+    static constexpr uint32_t CONFIG_QUEUE_MODE = 0x3u << CONFIG_QUEUE_MODE_SHIFT;
+
+    bool configFlag(uint32_t aFlag) const {
+      return (mConfig.load(std::memory_order_relaxed) & aFlag) != 0;
+    }
+
+    // Replaces the bits of mConfig in aMask with aValue, returns the previous configuration
+    uint32_t setConfig(uint32_t aMask, uint32_t aValue);
+
+    // configure() without mConfigureMutex
+    bool applySettings(const settings &aSettings);
+
+    // Message record. Records are preallocated in mPool and recycled by the worker, the location
+    // is stored as a pointer to the static call site.
     class container {
     public:
-      container(const std::string &_str,
-                const bool &_printTimestamp,
-                const bool &_printLocation,
-                const bool &_os,
-                const bool &_ofs,
-                const int &_line,
-                const std::string &_file,
-                const std::string &_function,
-                const size_t &_verbosity);
+      container();
       container(const container &c);
-      container(const container &&c);
+      container(container &&c) noexcept;
       ~container();
 
-      const std::string str;
-      const bool printTimestamp;
-      const bool printLocation;
-      const bool os;
-      const bool ofs;
-      const std::chrono::system_clock::time_point time;
-      const int line;
-      const std::string file;
-      const std::string function;
-      const size_t verbosity;
+      void set(const bool &_printTimestamp,
+               const bool &_printLocation,
+               const bool &_os,
+               const bool &_ofs,
+               const callSite *_site,
+               const size_t &_verbosity);
+
+      std::string_view str() const;
+
+      bool printTimestamp;
+      bool printLocation;
+      sinkMask sinks;
+      std::chrono::system_clock::time_point time;
+      uint64_t thread;
+      const callSite *site;
+      size_t verbosity;
+      bool pooled;
+      decoder decode;  // Formats body on the worker, nullptr if body is already text
+      messageBuffer body;
     };
 
+    // Message buffer owned by a single producing thread
+    struct threadBuffer {
+      std::mutex mutex;          // Only contended while the worker collects the buffer
+      std::atomic<out *> owner;  // Cleared under mutex when the logger shuts down, read by the owning thread
+      std::vector<container *> messages;
+    };
+
+    // Reserves a record from mPool, or the heap if the pool is exhausted
+    container *acquire(const bool &_printTimestamp,
+                       const bool &_printLocation,
+                       const bool &_os,
+                       const bool &_ofs,
+                       callSite &_site,
+                       const size_t &_verbosity);
+
+    // Call site for a location passed to print/printf/write directly
+    static callSite &locationSite(int aLine, const char *aFile, const char *aFunction);
+    static callSite &locationSite(int aLine, const std::string &aFile, const std::string &aFunction);
+
+    // Returns a record to mPool
+    void release(container *c);
+
+    // Writes the message body, or its raw arguments if formatting is deferred
+    template <typename... Args>
+    void store(container *c, Args &&... args) {
+      // A deferred string is copied all the same, so moved strings are stored directly
+      if constexpr (deferrable<Args...> && !movesString<Args...>) {
+        if (configFlag(CONFIG_DEFERRED)) {
+          encode(c->body, std::forward<Args>(args)...);
+          c->decode = decoderFor<Args...>();
+          return;
+        }
+      }
+      format(c->body, std::forward<Args>(args)...);
+    }
+
+    // Hands a message to outputThread(), or to the flight recorder
+    void enqueue(container *c);
+
+    // Stores c in the flight recorder, releasing the message it replaces
+    void record(container *c);
+
+    // Empties the flight recorder. aCrash gives up on mSinkMutex after mShutdownTimeout and uses std::cerr.
+    size_t dumpRecorder(bool aCrash);
+
+    // Starts outputThread(), or attaches to mWorkerPool, on first use
+    void startWorker();
+
+    // Waits for outputThread() or the pool to finish the final drain
+    void joinWorker();
+
+    // Applies mOverflowPolicy when the queue is full, returns false if c must be dropped
+    bool makeRoom(container *c, size_t aCapacity);
+
+    // Discards the oldest queued message, returns false if none is queued
+    bool dropOldest();
+
+    // Returns the calling thread's buffer for this logger
+    threadBuffer &localBuffer();
+
+    // Hands a batch of messages to outputThread()
+    void handOff(std::vector<container *> &&aBatch);
+
+    // Hands every non-empty thread buffer to outputThread()
+    void collectThreadBuffers();
+
+    // Deletes all queued messages, used on shutdown
+    void clearQueue();
+
+    // True if either file backend is open
+    bool logOpen();
+
+    // Opens a new log file in mFileMode if none is open, mSinkMutex must be held
+    bool openLog();
+
+    // Opens mLogFilename with the backend for aMode, mSinkMutex must be held
+    bool openBackend(FILE_MODE aMode);
+
+    // Closes every backend of the log file, mSinkMutex must be held
+    void closeLog();
+
+    // Moves the log file to the backend for aMode, mSinkMutex must be held
+    bool switchFileMode(FILE_MODE aMode);
+
+    // Returns an unused log file path in mLogDirectory
+    std::string nextLogFilename();
+
+    // Log rotation, called by the worker with mSinkMutex held
+    bool rotationDue();
+    void rotate();
+
+    // Called by the worker before it adds aBytes to mOFSBuffer. If they would take the log file past mRotateSize,
+    // writes mOFSBuffer to the current file and rotates. Returns true if the file was rotated.
+    bool rotateBefore(size_t aBytes);
+
+    // Appends aData to the current log file, mSinkMutex must be held
+    void writeLog(const std::string &aData);
+
+    // True if both the ring buffer and the mutex queue are empty
+    bool queueEmpty();
+
     // Thread used for printing
     void outputThread();
 
-    // Returns timestamp as string
-    std::string getTimestamp(std::chrono::system_clock::time_point time);
+    // One pass of the worker: writes a batch, or handles flush requests and timers if there is none.
+    // Returns true if a batch was written. _flushPending is set if an interval flush is still due.
+    bool step(bool &_flushPending);
 
-    std::atomic<bool> mEnable;
-    std::atomic<bool> mEnableOS;
-    std::atomic<bool> mEnableOFS;
+    // Runs up to DBG_OUT_POOL_BATCHES steps on a pool thread, returns true if the logger must be queued again
+    bool poolRun();
 
-    std::atomic<bool> mDisable;
+    // Wakes the worker, or queues the logger on its pool if it is idle there
+    void notifyWorker();
 
-    std::string mLogFilename;
+    // Writes queued messages until the queue is empty or the shutdown timeout has passed, called by the worker
+    void finalDrain();
+
+    // Waits for the worker to write and flush the messages queued so far, used by the crash handlers
+    void crashFlush();
+    static void crashFlushAll();
+    static void crashSignalHandler(int aSignal);
+    static void crashTerminateHandler();
+
+    // Renders up to DBG_OUT_BATCH_SIZE queued messages into the sink buffers, returns the count
+    size_t drain();
+
+    // Appends a message to the sink buffers and releases it
+    void render(container *c);
+
+    // Renders a line reporting dropped messages, at most every DBG_OUT_DROP_REPORT_MS
+    bool reportDrops();
+
+    // Renders a line for every site which suppressed calls, at most every DBG_OUT_DROP_REPORT_MS
+    bool reportSuppressed();
+
+    // Replaces the trace sink, see traceSink()
+    sinkMask setTraceSink(std::shared_ptr<sink> aSink);
+
+    // Registers aSink and returns its bit, mSinkMutex must be held
+    sinkMask registerSink(std::shared_ptr<sink> aSink);
+
+    // Copies mSinks for the worker if it has changed, mSinkMutex must be held
+    void updateSinks();
+
+    // Writes the sink buffers, aCount is the number of messages they contain
+    void writeBatch(size_t aCount);
 
-    std::atomic<bool> mDefaultTimestamp;
-    std::atomic<bool> mDefaultLocation;
+    // Messages accepted but not yet completed
+    size_t pending() const;
 
-    std::atomic<bool> mFlush;
-    std::atomic<bool> mNewline;
+    // Advances mCompleted by aCount and wakes threads waiting for it
+    void complete(size_t aCount);
 
-    std::atomic<uint8_t> mVerbosity;
+    // Adds the batch's messages and aBytes to the metrics of the sink at aIndex, mSinkMutex must be held
+    void countSink(size_t aIndex, size_t aBytes);
 
+    // Adds the batch's enqueue-to-write latencies to mLatency
+    void countLatency();
+
+    // Flushes the sinks if required by mFlushPolicy, or if aForce. mSinkMutex must be held.
+    void flushSinks(bool aForce);
+
+    // Appends the formatted message to aLine. _second and _date cache the date part of the timestamp.
+    static void appendLine(std::string &aLine,
+                           const container &c,
+                           std::string_view aBody,
+                           bool aNewline,
+                           time_t &_second,
+                           std::string &_date);
+
+    // Appends "<date> HH:MM:SS.uuuuuu" to aOutput, _date caches everything up to the microseconds for _second
+    static void appendTimestamp(std::string &aOutput,
+                                std::chrono::system_clock::time_point time,
+                                time_t &_second,
+                                std::string &_date);
+
+    // Hot state is split by writer so that producers on many cores do not share cache lines with the worker.
+
+    // Read-mostly configuration, CONFIG_* bits. One load answers accepts() and supplies the message defaults.
+    alignas(DBG_OUT_CACHE_LINE_SIZE) std::atomic<uint32_t> mConfig;
+    std::atomic<size_t> mCapacity;
+    std::atomic<OVERFLOW_POLICY> mOverflowPolicy;
+    std::atomic<uint8_t> mDropVerbosity;
+    // Set while messages are waiting in mMessages, later LOCK_FREE messages follow them there to keep their order
+    std::atomic<bool> mOverflowing;
+
+    // Flush barrier, a message has sequence n if it was the nth accepted by enqueue().
+    // Everything up to mCompleted has been written or discarded.
+    // mEnqueued is incremented by every producer, in THREAD_LOCAL mode once per hand-off. mCompleted by the worker.
+    alignas(DBG_OUT_CACHE_LINE_SIZE) std::atomic<uint64_t> mEnqueued;
+    alignas(DBG_OUT_CACHE_LINE_SIZE) std::atomic<uint64_t> mCompleted;
+    std::atomic<size_t> mWaiters;  // Threads blocked in wait()
+
+    // Written by the worker each time it goes to sleep, read by producers after every push
+    alignas(DBG_OUT_CACHE_LINE_SIZE) std::atomic<bool> mWorkerWaiting;
+
+    // Written by producers when the queue is full, mHighWater only by the worker
+    alignas(DBG_OUT_CACHE_LINE_SIZE) std::atomic<size_t> mHighWater;
+    std::atomic<size_t> mDropped;
+    std::atomic<size_t> mBlockedProducers;
+
+    // Flight recorder, written by producers in FLIGHT_RECORDER mode only
+    alignas(DBG_OUT_CACHE_LINE_SIZE) std::atomic<size_t> mRecorderPos;
+    const std::unique_ptr<std::atomic<container *>[]> mRecorder;
+
+    // Everything below is cold for producers
+    alignas(DBG_OUT_CACHE_LINE_SIZE) std::atomic<FLUSH_POLICY> mFlushPolicy;
+    std::atomic<size_t> mFlushThreshold;
+
+    const std::string mName;
+    const bool mIsDefault;  // This is instance()
+
+    // Guarded by mSinkMutex
+    std::string mLogDirectory;
+    std::string mLogName;
+    std::string mLogFilename;
+
+    std::atomic<FILE_MODE> mFileMode;
     std::ofstream mOFS;
+    mappedFile mMappedFile;
+    asyncFile mAsyncFile;
+
+    // Worker-owned buffer for deferred messages
+    messageBuffer mDecodeBuffer;
+
+    // Worker-owned "<date> HH:MM:SS." prefix, refreshed when the second changes
+    time_t mTimestampSecond;
+    std::string mTimestampDate;
+
+    // Worker-owned output buffers, written once per batch
+    std::string mLine;
+    std::string mRecord;  // Binary record of the message being rendered
+    std::string mOSBuffer;
+    std::string mOFSBuffer;
+    size_t mOFSWritten;  // Bytes of the current batch already written by rotateBefore()
+
+    // Guarded by mSinkMutex
+    size_t mUnflushedMessages;
+    size_t mUnflushedBytes;
+    std::chrono::steady_clock::time_point mLastFlush;
+    std::mutex mSinkMutex;
+
+    struct registeredSink {
+      sinkMask mask;
+      std::shared_ptr<sink> target;
+      bool records;  // target->wantsRecords()
+    };
 
-    bool mStop;
+    // Guarded by mSinkMutex, changes also take mSinkListMutex so that getMetrics() can read it without mSinkMutex
+    std::vector<registeredSink> mSinks;
+    std::mutex mSinkListMutex;
+    bool mSinksChanged;
+    std::atomic<sinkMask> mTraceMask;  // Written under mSinkMutex, read by trace()
+
+    // Worker-owned copy of mSinks and their output buffers
+    std::vector<registeredSink> mActiveSinks;
+    sinkMask mActiveMask;
+    sinkMask mActiveTraceMask;
+    uint32_t mBatchConfig;  // mConfig as of the start of the current batch
+    std::vector<std::string> mSinkBuffers;
+    std::vector<size_t> mSinkRecordBytes;  // Written through writeRecord() in the current batch
+
+    std::atomic<LOG_FORMAT> mLogFormat;
+    LOG_FORMAT mActiveFormat;  // Format of the open log file
+    bool mRotateRequested;
+    binaryWriter mBinaryWriter;
+
+    std::atomic<size_t> mRotateSize;
+    std::atomic<size_t> mRotateInterval;
+    std::atomic<bool> mCompress;
+    std::atomic<size_t> mSegmentBytes;  // Written under mSinkMutex, also read by the worker while it renders
+    std::chrono::steady_clock::time_point mSegmentStart;
+    compressor mCompressor;
+
+    std::mutex mConfigureMutex;  // Serializes configure()
+    configWatcher mConfigWatcher;
+
+    std::atomic<bool> mStop;
+    std::atomic<size_t> mShutdownTimeout;
+    bool mFinalDrain;                   // Worker-owned, suppresses flushes until the final drain completes
+    std::atomic<bool> mFlushRequested;  // Set by crashFlush(), cleared by the worker once it has flushed
     std::thread mWorker;
+    std::once_flag mWorkerStarted;
+    std::chrono::steady_clock::time_point mLastCollect;  // Worker-owned, last collection of the thread buffers
+
+    // Used instead of mWorker if set. mWorkerWaiting is set while the logger is idle and not queued on the pool.
+    const std::shared_ptr<workerPool> mWorkerPool;
+    std::atomic<bool> mPoolAttached;
+    bool mPoolStopped;  // Final drain done on the pool, guarded by mTaskFinishedMutex
+
+    // Metrics written by the worker
+    std::atomic<uint64_t> mWritten;
+    std::atomic<uint64_t> mFormatTime;
+    std::atomic<uint64_t> mIOTime;
+    std::atomic<uint64_t> mLatency[LATENCY_BUCKETS];
+    std::atomic<uint64_t> mSinkMessages[SINK_BITS];
+    std::atomic<uint64_t> mSinkBytes[SINK_BITS];
+
+    // Worker-owned, messages per sink and their times for the batch being rendered
+    uint64_t mBatchMessages[SINK_BITS];
+    std::vector<std::chrono::system_clock::time_point> mBatchTimes;
+
+    // Drop and suppression reports, worker-owned
+    size_t mDroppedReported;
+    std::chrono::steady_clock::time_point mLastDropReport;
+    std::chrono::steady_clock::time_point mLastSuppressedReport;
+    bool mSuppressedPending;  // A site flagged suppressed calls which are not reported yet
+
+    std::mutex mSpaceMutex;
+    std::condition_variable mSpaceCondition;
+    std::unique_ptr<container[]> mPool;
+    ringBuffer<container *> mFreeContainers;
+    ringBuffer<container *> mRing;
     std::queue<container *> mMessages;
+    std::vector<std::vector<container *>> mBatches;
+    std::vector<std::shared_ptr<threadBuffer>> mThreadBuffers;
+    std::mutex mThreadBuffersMutex;
     std::mutex mQueueMutex;
     std::mutex mTaskFinishedMutex;
     std::condition_variable mQueueUpdatedCondition;
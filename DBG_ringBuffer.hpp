@@ -0,0 +1,136 @@
+/**
+* @Filename: DBG_ringBuffer.hpp
+* @Author:   Ben Sokol <Ben>
+* @Email:    ben@bensokol.com
+* @Created:  October 14th, 2026 [3:06pm]
+* @Modified: October 14th, 2026 [3:06pm]
+* @Version:  1.0.0
+*
+* Copyright (C) 2019 by Ben Sokol. All Rights Reserved.
+*/
+
+#ifndef DBG_RING_BUFFER_HPP
+#define DBG_RING_BUFFER_HPP
+
+#include <cstddef>  // size_t
+#include <cstdint>  // intptr_t
+
+#include <atomic>   // std::atomic
+#include <memory>   // std::unique_ptr
+#include <utility>  // std::move
+
+#ifndef DBG_OUT_CACHE_LINE_SIZE
+  #define DBG_OUT_CACHE_LINE_SIZE 64
+#endif
+
+namespace DBG {
+  // Bounded lock-free queue with preallocated slots.
+  // Any number of threads may push and pop.
+  // Each slot carries a sequence number which tells producers and consumers
+  // whether the slot is free to write or ready to read, so no locks are required.
+  template <typename T>
+  class ringBuffer {
+  public:
+    // Capacity is rounded up to the next power of two
+    explicit ringBuffer(size_t aCapacity) :
+        mCapacity(roundCapacity(aCapacity)),
+        mMask(mCapacity - 1),
+        mCells(new cell[mCapacity]) {
+      for (size_t i = 0; i < mCapacity; ++i) {
+        mCells[i].sequence.store(i, std::memory_order_relaxed);
+      }
+      mEnqueuePos.store(0, std::memory_order_relaxed);
+      mDequeuePos.store(0, std::memory_order_relaxed);
+    }
+
+    ringBuffer(const ringBuffer &) = delete;
+    ringBuffer &operator=(const ringBuffer &) = delete;
+
+    // Returns false if the buffer is full
+    bool push(T aValue) {
+      size_t pos = mEnqueuePos.load(std::memory_order_relaxed);
+      for (;;) {
+        cell &c = mCells[pos & mMask];
+        size_t seq = c.sequence.load(std::memory_order_acquire);
+        intptr_t diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos);
+        if (diff == 0) {
+          if (mEnqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+            c.data = std::move(aValue);
+            c.sequence.store(pos + 1, std::memory_order_release);
+            return true;
+          }
+        }
+        else if (diff < 0) {
+          return false;
+        }
+        else {
+          pos = mEnqueuePos.load(std::memory_order_relaxed);
+        }
+      }
+    }
+
+    // Returns false if the buffer is empty
+    bool pop(T &aValue) {
+      size_t pos = mDequeuePos.load(std::memory_order_relaxed);
+      for (;;) {
+        cell &c = mCells[pos & mMask];
+        size_t seq = c.sequence.load(std::memory_order_acquire);
+        intptr_t diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos + 1);
+        if (diff == 0) {
+          if (mDequeuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+            aValue = std::move(c.data);
+            c.sequence.store(pos + mCapacity, std::memory_order_release);
+            return true;
+          }
+        }
+        else if (diff < 0) {
+          return false;
+        }
+        else {
+          pos = mDequeuePos.load(std::memory_order_relaxed);
+        }
+      }
+    }
+
+    // True if the next slot to be read has not been published yet
+    bool empty() const {
+      size_t pos = mDequeuePos.load(std::memory_order_relaxed);
+      return mCells[pos & mMask].sequence.load(std::memory_order_seq_cst) != pos + 1;
+    }
+
+    // Approximate number of elements in the buffer
+    size_t size() const {
+      size_t head = mDequeuePos.load(std::memory_order_relaxed);
+      size_t tail = mEnqueuePos.load(std::memory_order_relaxed);
+      return tail > head ? tail - head : 0;
+    }
+
+    size_t capacity() const {
+      return mCapacity;
+    }
+
+  private:
+    struct cell {
+      std::atomic<size_t> sequence;
+      T data;
+    };
+
+    static size_t roundCapacity(size_t aCapacity) {
+      size_t capacity = 2;
+      while (capacity < aCapacity) {
+        capacity <<= 1;
+      }
+      return capacity;
+    }
+
+    const size_t mCapacity;
+    const size_t mMask;
+    const std::unique_ptr<cell[]> mCells;
+
+    // Producers and consumers each get their own cache line
+    alignas(DBG_OUT_CACHE_LINE_SIZE) std::atomic<size_t> mEnqueuePos;
+    alignas(DBG_OUT_CACHE_LINE_SIZE) std::atomic<size_t> mDequeuePos;
+  };
+}  // namespace DBG
+
+#endif
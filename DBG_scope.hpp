@@ -0,0 +1,91 @@
+/**
+* @Filename: DBG_scope.hpp
+* @Author:   Ben Sokol <Ben>
+* @Email:    ben@bensokol.com
+* @Created:  October 14th, 2026 [3:52pm]
+* @Modified: October 14th, 2026 [3:52pm]
+* @Version:  1.0.0
+*
+* Copyright (C) 2019 by Ben Sokol. All Rights Reserved.
+*/
+
+#ifndef DBG_SCOPE_HPP
+#define DBG_SCOPE_HPP
+
+#include <cstddef>  // size_t
+#include <cstdint>  // uint64_t
+
+#include "DBG_callSite.hpp"
+#include "DBG_clock.hpp"
+#include "DBG_out.hpp"
+
+// DBG_scope("name") times the rest of the enclosing block, DBG_scope_to(logger, "name") logs to another DBG::out.
+// The finished record is logged as "name took N us", or as a Chrome trace event if out::traceSink() is set.
+#ifndef DBG_OUT_SCOPE_MACROS
+  #define DBG_OUT_SCOPE_MACROS
+  #if !defined(NDEBUG) || defined(DBG_OUT_MAX_VERBOSITY)
+    #define DBG_OUT_scope_concat2(a, b) a##b
+    #define DBG_OUT_scope_concat(a, b)  DBG_OUT_scope_concat2(a, b)
+    // __COUNTER__ keeps two scopes on one line apart, e.g. when they come from one macro
+    #ifdef __COUNTER__
+      #define DBG_OUT_scope_unique __COUNTER__
+    #else
+      #define DBG_OUT_scope_unique __LINE__
+    #endif
+    // A single declaration, so it can go wherever a variable can. The site is a static in a lambda which is
+    // unique to the expansion, the location is taken outside of it so that it names the enclosing function.
+    #define DBG_scopev_to(logger, verbosity, name)                                     \
+      DBG::scope DBG_OUT_scope_concat(DBG_OUT_scope, DBG_OUT_scope_unique)(            \
+        logger,                                                                        \
+        [](const char *aFile, const char *aFunction, int aLine) -> DBG::callSite & {   \
+          static DBG::callSite site(aFile, aFunction, aLine);                          \
+          return site;                                                                 \
+        }(DBG_OUT_current_site_get),                                                   \
+        (verbosity) <= DBG_OUT_MAX_VERBOSITY,                                          \
+        verbosity,                                                                     \
+        name)
+    #define DBG_scopev(verbosity, name) DBG_scopev_to(DBG::out::instance(), verbosity, name)
+    #define DBG_scope(name)             DBG_scopev(0, name)
+    #define DBG_scope_to(logger, name)  DBG_scopev_to(logger, 0, name)
+  #else
+    #define DBG_scopev(verbosity, name)
+    #define DBG_scope(name)
+    #define DBG_scopev_to(logger, verbosity, name)
+    #define DBG_scope_to(logger, name)
+  #endif
+#endif
+
+namespace DBG {
+  // Measures its own lifetime on the calling thread, only the finished record is queued.
+  // aName must outlive the scope, it is copied when the record is queued.
+  class scope {
+  public:
+    scope(out &aLogger, callSite &aSite, bool aCompiled, size_t aVerbosity, const char *aName) :
+        mLogger(aLogger),
+        mSite(aSite),
+        mVerbosity(aVerbosity),
+        mName(aName),
+        mActive(aCompiled && aSite.enabled() && aLogger.accepts(aVerbosity)),
+        mStart(mActive ? tscClock::now() : 0) {
+    }
+
+    scope(const scope &) = delete;
+    scope &operator=(const scope &) = delete;
+
+    ~scope() {
+      if (mActive) {
+        mLogger.trace(mSite, mVerbosity, mName, mStart, tscClock::now());
+      }
+    }
+
+  private:
+    out &mLogger;
+    callSite &mSite;
+    const size_t mVerbosity;
+    const char *const mName;
+    const bool mActive;
+    const uint64_t mStart;
+  };
+}  // namespace DBG
+
+#endif
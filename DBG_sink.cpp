@@ -0,0 +1,191 @@
+/**
+* @Filename: DBG_sink.cpp
+* @Author:   Ben Sokol <Ben>
+* @Email:    ben@bensokol.com
+* @Created:  October 14th, 2026 [3:18pm]
+* @Modified: October 14th, 2026 [3:18pm]
+* @Version:  1.0.0
+*
+* Copyright (C) 2019 by Ben Sokol. All Rights Reserved.
+*/
+
+#include <cstddef>  // size_t
+
+#include <fstream>  // std::ofstream
+#include <memory>   // std::shared_ptr
+#include <mutex>    // std::mutex, std::unique_lock
+#include <ostream>  // std::ostream
+#include <string>   // std::string
+#include <thread>   // std::thread
+#include <utility>  // std::move
+
+#include "DBG_sink.hpp"
+
+namespace DBG {
+  sink::~sink() {
+  }
+
+
+  void sink::flush() {
+  }
+
+
+  size_t sink::dropped() const {
+    return 0;
+  }
+
+
+  bool sink::wantsRecords() const {
+    return false;
+  }
+
+
+  void sink::writeRecord(const sinkRecord &aRecord) {
+    write(aRecord.line.data(), aRecord.line.size());
+  }
+
+
+  streamSink::streamSink(std::ostream &aStream) : mStream(aStream) {
+  }
+
+
+  void streamSink::write(const char *aData, size_t aSize) {
+    mStream.write(aData, static_cast<std::streamsize>(aSize));
+  }
+
+
+  void streamSink::flush() {
+    mStream.flush();
+  }
+
+
+  fileSink::fileSink(const std::string &aPath, bool aMapped) {
+    if (!aMapped || !mMappedFile.open(aPath)) {
+      mOFS.open(aPath, std::ofstream::out | std::ofstream::app);
+    }
+  }
+
+
+  bool fileSink::isOpen() const {
+    return mMappedFile.isOpen() || mOFS.is_open();
+  }
+
+
+  void fileSink::write(const char *aData, size_t aSize) {
+    if (mMappedFile.isOpen()) {
+      mMappedFile.write(aData, aSize);
+    }
+    else if (mOFS.is_open()) {
+      mOFS.write(aData, static_cast<std::streamsize>(aSize));
+    }
+  }
+
+
+  void fileSink::flush() {
+    if (mMappedFile.isOpen()) {
+      mMappedFile.flush();
+    }
+    else if (mOFS.is_open()) {
+      mOFS.flush();
+    }
+  }
+
+
+  asyncSink::asyncSink(std::shared_ptr<sink> aSink, size_t aCapacity) :
+      mSink(std::move(aSink)),
+      mCapacity(aCapacity),
+      mStop(false),
+      mFlush(false),
+      mWriting(false),
+      mDropped(0) {
+    mWorker = std::thread(&asyncSink::writeThread, this);
+  }
+
+
+  asyncSink::~asyncSink() {
+    {
+      std::unique_lock<std::mutex> lock(mMutex);
+      mStop = true;
+    }
+    mBufferCondition.notify_one();
+    if (mWorker.joinable()) {
+      mWorker.join();
+    }
+  }
+
+
+  void asyncSink::write(const char *aData, size_t aSize) {
+    {
+      std::unique_lock<std::mutex> lock(mMutex);
+      if (mBuffer.size() + aSize > mCapacity) {
+        mDropped += aSize;
+        return;
+      }
+      mBuffer.append(aData, aSize);
+    }
+    mBufferCondition.notify_one();
+  }
+
+
+  void asyncSink::flush() {
+    {
+      std::unique_lock<std::mutex> lock(mMutex);
+      mFlush = true;
+    }
+    mBufferCondition.notify_one();
+  }
+
+
+  void asyncSink::wait() {
+    std::unique_lock<std::mutex> lock(mMutex);
+    mIdleCondition.wait(lock, [this]() {
+      return mBuffer.empty() && !mWriting;
+    });
+  }
+
+
+  size_t asyncSink::dropped() const {
+    return mDropped;
+  }
+
+
+  void asyncSink::writeThread() {
+    // The buffers are swapped, so both keep the capacity the largest batch needed
+    std::string writing;
+
+    for (;;) {
+      bool flush;
+
+      {
+        std::unique_lock<std::mutex> lock(mMutex);
+        mWriting = false;
+        mIdleCondition.notify_all();
+
+        mBufferCondition.wait(lock, [this]() {
+          return mStop || mFlush || !mBuffer.empty();
+        });
+
+        // Whatever is buffered is still written when stopping
+        if (mStop && mBuffer.empty()) {
+          break;
+        }
+
+        writing.swap(mBuffer);
+        flush = mFlush || mStop;
+        mFlush = false;
+        mWriting = true;
+      }
+
+      if (!writing.empty()) {
+        mSink->write(writing.data(), writing.size());
+        writing.clear();
+      }
+
+      if (flush) {
+        mSink->flush();
+      }
+    }
+
+    mSink->flush();
+  }
+}  // namespace DBG
@@ -0,0 +1,144 @@
+/**
+* @Filename: DBG_sink.hpp
+* @Author:   Ben Sokol <Ben>
+* @Email:    ben@bensokol.com
+* @Created:  October 14th, 2026 [3:18pm]
+* @Modified: October 14th, 2026 [3:18pm]
+* @Version:  1.0.0
+*
+* Copyright (C) 2019 by Ben Sokol. All Rights Reserved.
+*/
+
+#ifndef DBG_SINK_HPP
+#define DBG_SINK_HPP
+
+#include <cstddef>  // size_t
+#include <cstdint>  // uint8_t, uint64_t
+
+#include <atomic>              // std::atomic
+#include <chrono>              // std::chrono::system_clock::time_point
+#include <condition_variable>  // std::condition_variable
+#include <fstream>             // std::ofstream
+#include <memory>              // std::shared_ptr
+#include <mutex>               // std::mutex
+#include <ostream>             // std::ostream
+#include <string>              // std::string
+#include <string_view>         // std::string_view
+#include <thread>              // std::thread
+
+#include "DBG_mappedFile.hpp"
+
+// Bytes an asyncSink buffers before it starts dropping output
+#ifndef DBG_OUT_SINK_BUFFER_SIZE
+  #define DBG_OUT_SINK_BUFFER_SIZE (4 * 1024 * 1024)
+#endif
+
+namespace DBG {
+  // One bit per output destination of a message
+  using sinkMask = uint64_t;
+
+  constexpr sinkMask SINK_OS = 1;   // std::cerr
+  constexpr sinkMask SINK_OFS = 2;  // Log file
+  constexpr sinkMask SINK_ALL = ~sinkMask(0);
+  constexpr size_t SINK_BITS = sizeof(sinkMask) * 8;
+
+
+  class callSite;
+
+  // A single message as it is rendered by the worker
+  struct sinkRecord {
+    const callSite *site;
+    std::chrono::system_clock::time_point time;
+    uint64_t thread;
+    size_t verbosity;
+    uint8_t flags;          // binaryLog::TIMESTAMP, binaryLog::LOCATION and binaryLog::NEWLINE
+    std::string_view body;  // Message text only
+    std::string_view line;  // The message as it is written to the log file
+  };
+
+
+  // Destination for formatted output.
+  // write() is called from a single thread with one or more complete lines.
+  class sink {
+  public:
+    virtual ~sink();
+
+    virtual void write(const char *aData, size_t aSize) = 0;
+    virtual void flush();
+
+    // Sinks which return true receive every message through writeRecord() instead of batched lines.
+    // writeRecord() is called by the worker while it renders, possibly concurrently with flush().
+    virtual bool wantsRecords() const;
+    virtual void writeRecord(const sinkRecord &aRecord);
+
+    // Bytes the sink discarded, 0 for sinks which never drop output
+    virtual size_t dropped() const;
+  };
+
+
+  // Writes to an existing stream, such as std::cerr
+  class streamSink : public sink {
+  public:
+    explicit streamSink(std::ostream &aStream);
+
+    void write(const char *aData, size_t aSize) override;
+    void flush() override;
+
+  private:
+    std::ostream &mStream;
+  };
+
+
+  // Appends to a file through std::ofstream, or through mmap if aMapped
+  class fileSink : public sink {
+  public:
+    explicit fileSink(const std::string &aPath, bool aMapped = false);
+
+    bool isOpen() const;
+
+    void write(const char *aData, size_t aSize) override;
+    void flush() override;
+
+  private:
+    std::ofstream mOFS;
+    mappedFile mMappedFile;
+  };
+
+
+  // Runs another sink on its own thread so that a slow destination does not hold up the logger.
+  // Output is buffered up to aCapacity bytes, batches which do not fit are dropped and counted.
+  // Nothing is allocated up front. The sink keeps a buffer being filled and one being written, each grows to the
+  // largest backlog seen, so a sink which falls behind holds up to 2 * aCapacity bytes.
+  class asyncSink : public sink {
+  public:
+    explicit asyncSink(std::shared_ptr<sink> aSink, size_t aCapacity = DBG_OUT_SINK_BUFFER_SIZE);
+    ~asyncSink() override;
+
+    void write(const char *aData, size_t aSize) override;
+    void flush() override;
+
+    // Blocks until everything buffered has been written
+    void wait();
+
+    // Bytes dropped because the buffer was full
+    size_t dropped() const override;
+
+  private:
+    void writeThread();
+
+    const std::shared_ptr<sink> mSink;
+    const size_t mCapacity;
+
+    bool mStop;
+    bool mFlush;
+    bool mWriting;
+    std::string mBuffer;
+    std::atomic<size_t> mDropped;
+    std::thread mWorker;
+    std::mutex mMutex;
+    std::condition_variable mBufferCondition;
+    std::condition_variable mIdleCondition;
+  };
+}  // namespace DBG
+
+#endif
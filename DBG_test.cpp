@@ -0,0 +1,1555 @@
+/**
+* @Filename: DBG_test.cpp
+* @Author:   Ben Sokol <Ben>
+* @Email:    ben@bensokol.com
+* @Created:  October 14th, 2026 [4:55pm]
+* @Modified: October 14th, 2026 [4:55pm]
+* @Version:  1.0.0
+*
+* Copyright (C) 2019 by Ben Sokol. All Rights Reserved.
+*/
+
+// Tests for DBG::out and its parts. Build as its own executable together with every DBG_*.cpp file except
+// DBG_bench.cpp and DBG_decode.cpp. Log files go to DBG_test in the temporary directory, which is emptied first.
+// Runs every test in main(), or only the named ones, and exits with the number of failed tests.
+//
+//   DBG_test [test ...]
+
+// Messages above verbosity 200 are compiled out, see maxVerbosityTest()
+#define DBG_OUT_MAX_VERBOSITY 200
+
+#include <csignal>  // std::signal, SIGXFSZ
+#include <cstddef>  // size_t, std::ptrdiff_t
+#include <cstdint>  // int64_t, uint8_t, uint64_t
+#include <ctime>    // std::mktime, std::tm
+
+#include <algorithm>           // std::count_if, std::is_sorted
+#include <atomic>              // std::atomic
+#include <chrono>              // std::chrono::steady_clock, std::chrono::system_clock
+#include <condition_variable>  // std::condition_variable
+#include <fstream>             // std::ifstream
+#include <iomanip>             // std::get_time
+#include <iostream>            // std::cout
+#include <limits>              // std::numeric_limits
+#include <memory>              // std::make_shared
+#include <mutex>               // std::mutex, std::unique_lock
+#include <ostream>             // std::ostream
+#include <sstream>             // std::istringstream, std::ostringstream
+#include <string>              // std::string, std::to_string
+#include <string_view>         // std::string_view
+#include <system_error>        // std::error_code
+#include <thread>              // std::thread
+#include <utility>             // std::forward, std::move
+#include <vector>              // std::vector
+
+#include "DBG_asyncFile.hpp"
+#include "DBG_binaryLog.hpp"
+#include "DBG_networkSink.hpp"
+#include "DBG_out.hpp"
+#include "DBG_ringBuffer.hpp"
+#include "DBG_scope.hpp"
+#include "DBG_workerPool.hpp"
+
+#if __has_include(<sys/resource.h>)
+  #include <sys/resource.h>  // getrlimit, setrlimit
+  #define DBG_TEST_HAS_RLIMIT
+#endif
+
+// A local collector for DBG::networkSink
+#if __has_include(<arpa/inet.h>) && __has_include(<netinet/in.h>) && __has_include(<sys/socket.h>) \
+  && __has_include(<sys/time.h>) && __has_include(<unistd.h>)
+  #include <arpa/inet.h>   // htonl, ntohs
+  #include <netinet/in.h>  // sockaddr_in, INADDR_LOOPBACK
+  #include <sys/socket.h>  // socket, bind, listen, accept, recv, setsockopt
+  #include <sys/time.h>    // timeval
+  #include <unistd.h>      // close
+  #define DBG_TEST_HAS_SOCKETS
+#endif
+
+// Reads rotated files back, if DBG_compressor.cpp was built with zlib
+#if __has_include(<zlib.h>)
+  #include <zlib.h>  // gzopen, gzread, gzclose
+  #define DBG_TEST_HAS_ZLIB
+#endif
+
+#if __has_include(<filesystem>)
+  #include <filesystem>
+  #ifndef std_filesystem
+    #define std_filesystem std::filesystem
+  #endif
+#elif __has_include(<experimental/filesystem>)
+  #include <experimental/filesystem>
+  #ifndef std_filesystem
+    #define std_filesystem std::experimental::filesystem
+  #endif
+#endif
+
+namespace {
+  // Written by a formatter specialization
+  struct point {
+    int x;
+    int y;
+  };
+
+  // Written through the operator<< fallback
+  struct streamable {
+    int value;
+  };
+
+  std::ostream &operator<<(std::ostream &aStream, const streamable &aValue) {
+    return aStream << "<" << aValue.value << ">";
+  }
+}  // namespace
+
+namespace DBG {
+  template <>
+  struct formatter<point> {
+    static void format(messageBuffer &aBuffer, const point &aValue) {
+      DBG::format(aBuffer, "(", aValue.x, ", ", aValue.y, ")");
+    }
+  };
+}  // namespace DBG
+
+namespace {
+  size_t failures = 0;
+
+  void check(bool aCondition, const std::string &aWhat) {
+    if (!aCondition) {
+      std::cout << "  failed: " << aWhat << "\n";
+      ++failures;
+    }
+  }
+
+
+  // Polls aCondition for up to aSeconds
+  template <typename Condition>
+  bool waitFor(Condition &&aCondition, int aSeconds = 10) {
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(aSeconds);
+    while (!aCondition()) {
+      if (std::chrono::steady_clock::now() >= deadline) {
+        return false;
+      }
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    return true;
+  }
+
+
+  std::string directory(const std::string &aTest) {
+    return (std_filesystem::temp_directory_path() / "DBG_test" / aTest).string();
+  }
+
+
+  std::vector<std::string> files(const std::string &aDirectory) {
+    std::vector<std::string> paths;
+    std::error_code error;
+    for (auto &entry : std_filesystem::directory_iterator(aDirectory, error)) {
+      paths.push_back(entry.path().string());
+    }
+    return paths;
+  }
+
+
+  std::string contents(const std::string &aPath) {
+    std::ifstream file(aPath, std::ifstream::binary);
+    return std::string((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+  }
+
+
+  std::vector<std::string> splitLines(const std::string &aText) {
+    std::vector<std::string> result;
+    std::istringstream stream(aText);
+    for (std::string line; std::getline(stream, line);) {
+      result.push_back(line);
+    }
+    return result;
+  }
+
+
+  std::vector<std::string> fileLines(const std::string &aPath) {
+    return splitLines(contents(aPath));
+  }
+
+
+  // Lines "0" to "aCount - 1"
+  std::vector<std::string> numbers(size_t aCount) {
+    std::vector<std::string> result;
+    for (size_t i = 0; i < aCount; ++i) {
+      result.push_back(std::to_string(i));
+    }
+    return result;
+  }
+
+
+  // Keeps every line it is given. A closed gate holds up the worker in write() until it is opened.
+  class captureSink : public DBG::sink {
+  public:
+    captureSink() : mOpen(true), mWaiting(false) {
+    }
+
+    void write(const char *aData, size_t aSize) override {
+      std::unique_lock<std::mutex> lock(mMutex);
+      mWaiting = true;
+      mCondition.wait(lock, [this]() {
+        return mOpen;
+      });
+      mWaiting = false;
+      mText.append(aData, aSize);
+    }
+
+    void close() {
+      std::unique_lock<std::mutex> lock(mMutex);
+      mOpen = false;
+    }
+
+    void open() {
+      {
+        std::unique_lock<std::mutex> lock(mMutex);
+        mOpen = true;
+      }
+      mCondition.notify_all();
+    }
+
+    // True while the worker is held up by the gate
+    bool waiting() {
+      std::unique_lock<std::mutex> lock(mMutex);
+      return mWaiting;
+    }
+
+    std::vector<std::string> lines() {
+      std::unique_lock<std::mutex> lock(mMutex);
+      return splitLines(mText);
+    }
+
+  private:
+    bool mOpen;
+    bool mWaiting;
+    std::string mText;
+    std::mutex mMutex;
+    std::condition_variable mCondition;
+  };
+
+
+  // Output to registered sinks only, without timestamps or locations
+  void quiet(DBG::out &aOut) {
+    aOut.configure("enable=1 os=0 ofs=0 timestamp=0 location=0 newline=1 verbosity=0");
+  }
+
+
+  // Logs to a text log file in the test's directory, without timestamps or locations
+  void logToFile(DBG::out &aOut, const std::string &aTest) {
+    quiet(aOut);
+    aOut.logDirectory(directory(aTest));
+    aOut.configure("ofs=1");
+  }
+
+
+  void ringTest() {
+    DBG::ringBuffer<size_t> ring(5);
+    check(ring.capacity() == 8, "capacity is rounded up to a power of two");
+
+    size_t value = 0;
+    check(!ring.pop(value), "pop from an empty buffer fails");
+    for (size_t lap = 0; lap < 3; ++lap) {
+      for (size_t i = 0; i < ring.capacity(); ++i) {
+        check(ring.push(lap * 100 + i), "push into a buffer with room");
+      }
+      check(!ring.push(0), "push into a full buffer fails");
+      for (size_t i = 0; i < ring.capacity(); ++i) {
+        check(ring.pop(value) && value == lap * 100 + i, "values come out in the order they went in");
+      }
+      check(ring.empty(), "buffer is empty after popping everything");
+    }
+
+    // Every value arrives exactly once, and each consumer sees a producer's values in the order they were pushed
+    const size_t producers = 4;
+    const size_t consumers = 4;
+    const size_t perProducer = 100000;
+    DBG::ringBuffer<uint64_t> shared(1024);
+    std::vector<std::atomic<uint8_t>> seen(producers * perProducer);
+    std::atomic<size_t> popped(0);
+    std::atomic<size_t> reordered(0);
+
+    std::vector<std::thread> threads;
+    for (size_t p = 0; p < producers; ++p) {
+      threads.emplace_back([&shared, p]() {
+        for (uint64_t i = 0; i < perProducer; ++i) {
+          while (!shared.push(p << 32 | i)) {
+            std::this_thread::yield();
+          }
+        }
+      });
+    }
+    for (size_t c = 0; c < consumers; ++c) {
+      threads.emplace_back([&]() {
+        std::vector<int64_t> last(producers, -1);
+        uint64_t v;
+        while (popped.load() < producers * perProducer) {
+          if (!shared.pop(v)) {
+            std::this_thread::yield();
+            continue;
+          }
+          size_t p = static_cast<size_t>(v >> 32);
+          int64_t i = static_cast<int64_t>(v & 0xFFFFFFFF);
+          if (i <= last[p]) {
+            ++reordered;
+          }
+          last[p] = i;
+          seen[p * perProducer + static_cast<size_t>(i)].fetch_add(1);
+          ++popped;
+        }
+      });
+    }
+    for (auto &thread : threads) {
+      thread.join();
+    }
+
+    size_t duplicates = 0;
+    for (auto &count : seen) {
+      duplicates += count.load() != 1;
+    }
+    check(duplicates == 0, "every value is popped exactly once");
+    check(reordered == 0, "a producer's values are popped in order");
+  }
+
+
+  // The worker is held up until the producers are half done, so the ring buffer overflows into the mutex queue.
+  // The rest is logged while the worker drains both, which is when a message could overtake an older one.
+  void orderTest() {
+    const size_t threads = 8;
+    const size_t perThread = 20000;
+
+    using mode = DBG::out::QUEUE_MODE;
+    for (mode queueMode : {mode::LOCK_FREE, mode::MUTEX, mode::THREAD_LOCAL}) {
+      DBG::out log("order");
+      quiet(log);
+      log.queueMode(queueMode);
+      auto capture = std::make_shared<captureSink>();
+      log.addSink(capture);
+
+      capture->close();
+      DBG_print_to(log, "start");
+      check(waitFor([&capture]() {
+              return capture->waiting();
+            }),
+            "the worker reaches the closed sink in queue mode " + std::to_string(static_cast<int>(queueMode)));
+
+      std::atomic<size_t> logged(0);
+      std::vector<std::thread> producers;
+      for (size_t t = 0; t < threads; ++t) {
+        producers.emplace_back([&log, &logged, t]() {
+          for (size_t i = 0; i < perThread; ++i) {
+            DBG_print_to(log, t, " ", i);
+            logged.fetch_add(1, std::memory_order_relaxed);
+          }
+        });
+      }
+      waitFor([&logged]() {
+        return logged.load(std::memory_order_relaxed) >= threads * perThread / 2;
+      });
+      capture->open();
+      for (auto &producer : producers) {
+        producer.join();
+      }
+      log.wait();
+
+      std::vector<std::string> lines = capture->lines();
+      check(lines.size() == threads * perThread + 1, "every message is written once");
+
+      std::vector<size_t> next(threads, 0);
+      size_t reordered = 0;
+      for (size_t l = 1; l < lines.size(); ++l) {
+        size_t t = 0;
+        size_t i = 0;
+        std::istringstream(lines[l]) >> t >> i;
+        if (t >= threads || i != next[t]) {
+          ++reordered;
+        }
+        next[t < threads ? t : 0] = i + 1;
+      }
+      check(reordered == 0,
+            "each thread's messages keep their order in queue mode " + std::to_string(static_cast<int>(queueMode)));
+    }
+  }
+
+
+  // Thread buffers are handed off when their thread exits, and a thread can outlive many loggers
+  void threadBufferTest() {
+    auto capture = std::make_shared<captureSink>();
+    {
+      DBG::out log("thread_buffer");
+      quiet(log);
+      log.queueMode(DBG::out::QUEUE_MODE::THREAD_LOCAL);
+      log.addSink(capture);
+      std::thread([&log]() {
+        DBG_print_to(log, "exiting");
+      }).join();
+      log.wait();
+    }
+    check(capture->lines().size() == 1, "a buffer is handed off when its thread exits");
+
+    const size_t loggers = 1000;
+    for (size_t l = 0; l < loggers; ++l) {
+      DBG::out log("thread_buffer");
+      quiet(log);
+      log.queueMode(DBG::out::QUEUE_MODE::THREAD_LOCAL);
+      log.addSink(capture);
+      DBG_print_to(log, l);
+      log.wait();
+    }
+    check(capture->lines().size() == loggers + 1, "every short-lived logger writes its messages");
+  }
+
+
+  template <typename... Args>
+  std::string formatted(Args &&... args) {
+    DBG::messageBuffer buffer;
+    DBG::format(buffer, std::forward<Args>(args)...);
+    return std::string(buffer.view());
+  }
+
+
+  template <typename T>
+  std::string streamed(const T &aValue) {
+    std::ostringstream stream;
+    stream << aValue;
+    return stream.str();
+  }
+
+
+  // Numbers are written the way std::ostream writes them by default
+  void formatTest() {
+    for (int64_t value : {int64_t(0), int64_t(-12), std::numeric_limits<int64_t>::min()}) {
+      check(formatted(value) == streamed(value), "integer " + streamed(value));
+    }
+    check(formatted(std::numeric_limits<uint64_t>::max()) == streamed(std::numeric_limits<uint64_t>::max()),
+          "largest unsigned integer");
+    for (double value : {0.0, 1.5, -2.25, 1e-7, 123456789.0, 3.14159265, 1e300}) {
+      check(formatted(value) == streamed(value), "double " + streamed(value));
+    }
+    check(formatted(0.1f) == streamed(0.1f), "float");
+    check(formatted(true, false) == "10", "bool");
+    check(formatted('a', static_cast<signed char>('b'), static_cast<unsigned char>('c')) == "abc", "characters");
+
+    const char *null = nullptr;
+    std::string str("string");
+    check(formatted("literal ", str, " ", std::string_view("view"), null) == "literal string view", "strings");
+    check(formatted(nullptr) == "nullptr", "nullptr");
+    check(formatted(point{1, -2}) == "(1, -2)", "a formatter specialization is used");
+    check(formatted(streamable{3}) == "<3>", "operator<< is used without a formatter");
+  }
+
+
+  // Deferred messages are written the same as messages formatted by the caller
+  void deferredTest() {
+    std::vector<std::string> lines[2];
+    for (bool deferred : {false, true}) {
+      DBG::out log("deferred");
+      quiet(log);
+      log.deferredFormatting(deferred);
+      auto capture = std::make_shared<captureSink>();
+      log.addSink(capture);
+
+      // The worker is held up so that the strings are changed before it formats the messages
+      capture->close();
+      DBG_print_to(log, "start");
+      waitFor([&capture]() {
+        return capture->waiting();
+      });
+      std::string str("string");
+      const char *null = nullptr;
+      DBG_print_to(log, 1, " ", -2.5, " ", 'c', " ", true, " ", str, " ", std::string_view("view"), null);
+      DBG_print_to(log, nullptr, " ", point{3, 4}, " ", "literal");
+      DBG_print_to(log, streamable{5}, " ", str);
+      str = "changed";
+      capture->open();
+      log.wait();
+      lines[deferred] = capture->lines();
+    }
+
+    std::vector<std::string> expected = {"start", "1 -2.5 c 1 string view", "nullptr (3, 4) literal", "<5> string"};
+    check(lines[0] == expected, "messages formatted by the caller");
+    check(lines[1] == expected, "deferred messages, their strings are copied when they are logged");
+  }
+
+
+  // Timestamps are "<month> <day>, <year> HH:MM:SS.uuuuuu" in local time, the date part is cached per second
+  void timestampTest() {
+    DBG::out log("timestamp");
+    quiet(log);
+    log.configure("timestamp=1");
+    auto capture = std::make_shared<captureSink>();
+    log.addSink(capture);
+
+    std::vector<std::chrono::system_clock::time_point> before;
+    std::vector<std::chrono::system_clock::time_point> after;
+    for (size_t i = 0; i < 6; ++i) {
+      // The second half is logged in a later second than the first
+      if (i == 3) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1100));
+      }
+      before.push_back(std::chrono::floor<std::chrono::microseconds>(std::chrono::system_clock::now()));
+      DBG_print_to(log, i);
+      after.push_back(std::chrono::system_clock::now());
+      log.wait();
+    }
+
+    std::vector<std::string> lines = capture->lines();
+    check(lines.size() == before.size(), "every message is written");
+    for (size_t i = 0; i < lines.size() && i < before.size(); ++i) {
+      std::tm date = {};
+      std::istringstream stream(lines[i]);
+      stream >> std::get_time(&date, "%b %d, %Y %H:%M:%S");
+      std::string rest;
+      std::getline(stream, rest);
+      date.tm_isdst = -1;
+      bool parsed = !stream.fail() && rest.size() > 7 && rest[0] == '.'
+                    && rest.find_first_not_of("0123456789", 1) == 7 && rest.substr(7) == " - " + std::to_string(i);
+      check(parsed, "the timestamp is formatted: " + lines[i]);
+      if (!parsed) {
+        continue;
+      }
+
+      auto time = std::chrono::system_clock::from_time_t(std::mktime(&date))
+                  + std::chrono::microseconds(std::stoi(rest.substr(1, 6)));
+      check(before[i] <= time && time <= after[i], "the timestamp is the time of the message: " + lines[i]);
+    }
+  }
+
+
+  // Calls above DBG_OUT_MAX_VERBOSITY are removed whatever the logger's verbosity is
+  void maxVerbosityTest() {
+    DBG::out log("max_verbosity");
+    quiet(log);
+    log.verbosity(255);
+    auto capture = std::make_shared<captureSink>();
+    log.addSink(capture);
+
+    size_t evaluated = 0;
+    auto count = [&evaluated]() {
+      return ++evaluated;
+    };
+    size_t verbosity = 201;
+    DBG_printv_to(log, 200, count());
+    DBG_printv_to(log, 201, count());
+    DBG_printv_to(log, verbosity, count());
+    log.wait();
+
+    check(evaluated == 1, "arguments above DBG_OUT_MAX_VERBOSITY are not evaluated");
+    check(capture->lines() == std::vector<std::string>{"1"}, "only the message at DBG_OUT_MAX_VERBOSITY is written");
+  }
+
+
+  void mmapTest() {
+    // The unused part of the last chunk is removed when the file is closed
+    {
+      DBG::out log("mmap");
+      check(log.fileMode(DBG::out::FILE_MODE::MMAP), "the mmap backend is selected");
+      logToFile(log, "mmap");
+      const size_t messages = 10000;
+      for (size_t i = 0; i < messages; ++i) {
+        DBG_print_to(log, i);
+      }
+      log.wait();
+      check(log.fileMode() == DBG::out::FILE_MODE::MMAP, "the log file is mapped");
+      std::string path = log.getLogFilename();
+      log.shutdown();
+      check(fileLines(path) == numbers(messages), "every message is written to the mapped file");
+      check(contents(path).find('\0') == std::string::npos, "the closed file has no zero tail");
+    }
+
+#ifdef DBG_TEST_HAS_RLIMIT
+    // A file size limit between the first and second chunk makes growing the mapping fail
+    DBG::out log("mmap_fallback");
+    log.fileMode(DBG::out::FILE_MODE::MMAP);
+    logToFile(log, "mmap_fallback");
+    DBG_print_to(log, 0);
+    log.wait();
+
+    struct rlimit limit;
+    getrlimit(RLIMIT_FSIZE, &limit);
+    struct rlimit restore = limit;
+    limit.rlim_cur = 2 * DBG_OUT_MMAP_MIN_CHUNK_SIZE;
+    auto handler = std::signal(SIGXFSZ, SIG_IGN);
+    setrlimit(RLIMIT_FSIZE, &limit);
+
+    // About 1.5 chunks of text
+    const size_t messages = DBG_OUT_MMAP_MIN_CHUNK_SIZE / 5;
+    for (size_t i = 1; i < messages; ++i) {
+      DBG_print_to(log, i);
+    }
+    log.wait();
+    setrlimit(RLIMIT_FSIZE, &restore);
+    std::signal(SIGXFSZ, handler);
+
+    check(log.fileMode() == DBG::out::FILE_MODE::STREAM, "the log continues in STREAM mode");
+    DBG_print_to(log, messages);
+    std::string path = log.getLogFilename();
+    log.shutdown();
+    check(fileLines(path) == numbers(messages + 1), "no message is lost when the mapping can not grow");
+    check(contents(path).find('\0') == std::string::npos, "the fallback continues after the written data");
+#endif
+  }
+
+
+  // Writes aMessages messages and one larger than aLimit, returns the log files
+  std::vector<std::string> rotatedLog(const std::string &aName, DBG::out::LOG_FORMAT aFormat, size_t aLimit,
+                                      size_t aMessages) {
+    DBG::out log(aName);
+    log.logDirectory(directory(aName));
+    log.logFormat(aFormat);
+    log.configure("enable=1 os=0 ofs=1 timestamp=1 location=1 newline=1 verbosity=0");
+    log.rotateSize(aLimit);
+
+    for (size_t i = 0; i < aMessages; ++i) {
+      DBG_print_to(log, "message ", i, " of a log which is rotated by size");
+      if (i == aMessages / 2) {
+        DBG_print_to(log, std::string(aLimit + aLimit / 2, 'x'));
+      }
+    }
+    log.shutdown();
+    return files(directory(aName));
+  }
+
+
+  void rotationTest() {
+    const size_t limit = 10000;
+    const size_t messages = 20000;
+
+    std::vector<std::string> text = rotatedLog("rotation", DBG::out::LOG_FORMAT::TEXT, limit, messages);
+    check(text.size() > messages * 60 / limit, "the log is split into files");
+    size_t lines = 0;
+    for (auto &path : text) {
+      std::string file = contents(path);
+      bool large = file.find(std::string(limit, 'x')) != std::string::npos;
+      check(file.size() <= limit || large, "only the file with the large message exceeds the limit: " + path);
+      for (char c : file) {
+        lines += c == '\n';
+      }
+    }
+    check(lines == messages + 1, "no message is lost when rotating");
+
+    // Every file has to define the sites it uses
+    std::vector<std::string> binary = rotatedLog("rotation_binary", DBG::out::LOG_FORMAT::BINARY, limit, messages);
+    check(binary.size() > 1, "the binary log is split into files");
+    size_t decoded = 0;
+    for (auto &path : binary) {
+      check(std_filesystem::file_size(path) <= limit + limit / 2 + 200, "binary file stays near the limit: " + path);
+      std::ifstream file(path, std::ifstream::binary);
+      DBG::binaryReader reader(file);
+      check(reader.valid(), "every binary file starts with a header");
+      DBG::binaryLog::message message;
+      while (reader.next(message)) {
+        check(reader.site(message.site).line != 0, "every message's site is defined in its own file");
+        ++decoded;
+      }
+    }
+    check(decoded == messages + 1, "every binary message decodes");
+
+#ifdef DBG_TEST_HAS_ZLIB
+    // Every file but the open one is replaced by its .gz
+    DBG::out log("rotation_gzip");
+    logToFile(log, "rotation_gzip");
+    log.rotateSize(limit);
+    log.compressRotated(true);
+    for (size_t i = 0; i < messages; ++i) {
+      DBG_print_to(log, i);
+    }
+    log.wait();
+    auto uncompressed = []() {
+      size_t count = 0;
+      for (auto &path : files(directory("rotation_gzip"))) {
+        count += path.size() < 3 || path.compare(path.size() - 3, 3, ".gz") != 0;
+      }
+      return count;
+    };
+    check(waitFor([&uncompressed]() {
+            return uncompressed() == 1;
+          }),
+          "rotated files are compressed");
+    log.shutdown();
+
+    std::string unpacked;
+    for (auto &path : files(directory("rotation_gzip"))) {
+      gzFile file = gzopen(path.c_str(), "rb");
+      char buffer[4096];
+      for (int read; file != nullptr && (read = gzread(file, buffer, sizeof(buffer))) > 0;) {
+        unpacked.append(buffer, static_cast<size_t>(read));
+      }
+      if (file != nullptr) {
+        gzclose(file);
+      }
+    }
+    check(splitLines(unpacked).size() == messages, "the compressed files hold every message");
+#endif
+  }
+
+
+  void sinkTest() {
+    DBG::out log("sink");
+    quiet(log);
+    auto capture = std::make_shared<captureSink>();
+    DBG::sinkMask mask = log.addSink(capture);
+    check(mask != 0 && (mask & (DBG::SINK_OS | DBG::SINK_OFS)) == 0, "a sink gets a bit of its own");
+
+    // Registered sinks receive what goes to std::cerr or the log file
+    DBG_print_to(log, "print");
+    DBG_printf_to(log, "printf");
+    DBG_write_to(log, false, false, true, false, "os");
+    DBG_write_to(log, false, false, false, true, "ofs");
+    DBG_write_to(log, false, false, false, false, "nowhere");
+    log.wait();
+    log.removeSink(mask);
+    DBG_print_to(log, "removed");
+    log.wait();
+    check(capture->lines() == std::vector<std::string>{"print", "printf", "os", "ofs"},
+          "sinks receive messages for std::cerr or the log file until they are removed");
+
+    // An asyncSink only buffers up to its capacity while the sink it wraps is busy
+    auto blocked = std::make_shared<captureSink>();
+    auto async = std::make_shared<DBG::asyncSink>(blocked, 10);
+    blocked->close();
+    async->write("first\n", 6);
+    check(waitFor([&blocked]() {
+            return blocked->waiting();
+          }),
+          "the asyncSink writes on its own thread");
+    async->write("fits\n", 5);
+    async->write("dropped\n", 8);
+    async->write("fits\n", 5);
+    check(async->dropped() == 8, "output which does not fit is dropped and counted");
+    blocked->open();
+    async->wait();
+    check(blocked->lines() == std::vector<std::string>{"first", "fits", "fits"}, "buffered output is written");
+  }
+
+
+  struct overflowResult {
+    std::vector<size_t> written;  // Numbers of the messages which were written
+    size_t dropped;
+    size_t reported;  // Sum of the drop reports in the log
+    size_t depth;     // Queue depth once every message was logged
+  };
+
+
+  // Logs aMessages numbered messages while the worker is held up, odd ones at verbosity 1
+  overflowResult overflow(DBG::out::QUEUE_MODE aMode, DBG::out::OVERFLOW_POLICY aPolicy, size_t aCapacity,
+                          size_t aMessages) {
+    DBG::out log("overflow");
+    quiet(log);
+    log.verbosity(1);
+    log.queueMode(aMode);
+    auto capture = std::make_shared<captureSink>();
+    log.addSink(capture);
+
+    capture->close();
+    DBG_print_to(log, "start");
+    waitFor([&capture]() {
+      return capture->waiting();
+    });
+    log.queueCapacity(aCapacity, aPolicy, 1);
+    for (size_t i = 0; i < aMessages; ++i) {
+      DBG_printv_to(log, i % 2, i);
+    }
+
+    overflowResult result{{}, 0, 0, log.remainingMessages()};
+    capture->open();
+    log.wait();
+    result.dropped = log.droppedMessages();
+
+    // Drops are reported at most every DBG_OUT_DROP_REPORT_MS
+    const std::string report = "DBG::out dropped ";
+    waitFor([&]() {
+      result.written.clear();
+      result.reported = 0;
+      for (auto &line : capture->lines()) {
+        if (line.compare(0, report.size(), report) == 0) {
+          result.reported += std::stoul(line.substr(report.size()));
+        }
+        else if (line != "start") {
+          result.written.push_back(std::stoul(line));
+        }
+      }
+      return result.reported == result.dropped;
+    });
+    return result;
+  }
+
+
+  void overflowTest() {
+    using mode = DBG::out::QUEUE_MODE;
+    using policy = DBG::out::OVERFLOW_POLICY;
+    const size_t capacity = 100;
+    const size_t messages = 1000;
+
+    for (mode queueMode : {mode::LOCK_FREE, mode::MUTEX, mode::THREAD_LOCAL}) {
+      std::string name = " in queue mode " + std::to_string(static_cast<int>(queueMode));
+
+      // Thread buffers are only counted once they are handed off
+      for (policy overflowPolicy : {policy::DROP_NEWEST, policy::DROP_OLDEST, policy::DROP_VERBOSE}) {
+        overflowResult result = overflow(queueMode, overflowPolicy, capacity, messages);
+        std::string what = name + " with policy " + std::to_string(static_cast<int>(overflowPolicy));
+        // DROP_VERBOSE keeps every message below the drop verbosity
+        check(result.depth <= capacity + DBG_OUT_THREAD_BUFFER_SIZE || overflowPolicy == policy::DROP_VERBOSE,
+              "the capacity is enforced" + what);
+        check(result.dropped > 0 && result.written.size() + result.dropped == messages,
+              "every message is either written or dropped" + what);
+        check(result.reported == result.dropped, "drops are reported in the log" + what);
+        check(std::is_sorted(result.written.begin(), result.written.end()), "messages keep their order" + what);
+
+        // The queue is a window of consecutive messages, the policy decides at which end it is cut
+        bool kept = !result.written.empty();
+        if (overflowPolicy == policy::DROP_NEWEST) {
+          kept = kept && result.written.back() == result.written.size() - 1;
+        }
+        else if (overflowPolicy == policy::DROP_OLDEST) {
+          kept = kept && result.written.front() == messages - result.written.size();
+        }
+        else {
+          kept = kept && std::count_if(result.written.begin(), result.written.end(), [](size_t i) {
+                           return i % 2 == 0;
+                         }) == static_cast<std::ptrdiff_t>(messages / 2);
+        }
+        check(kept, "the policy keeps the right messages" + what);
+      }
+
+      // BLOCK holds up the producer until the worker has made room
+      DBG::out log("overflow_block");
+      quiet(log);
+      log.queueMode(queueMode);
+      auto capture = std::make_shared<captureSink>();
+      log.addSink(capture);
+      capture->close();
+      DBG_print_to(log, 0);
+      waitFor([&capture]() {
+        return capture->waiting();
+      });
+      log.queueCapacity(capacity, policy::BLOCK);
+
+      std::atomic<size_t> logged(1);
+      std::thread producer([&log, &logged]() {
+        for (size_t i = 1; i < messages; ++i) {
+          DBG_print_to(log, i);
+          logged.fetch_add(1);
+        }
+      });
+      std::this_thread::sleep_for(std::chrono::milliseconds(100));
+      check(logged.load() < capacity + DBG_OUT_THREAD_BUFFER_SIZE + 1, "a full queue blocks the producer" + name);
+      capture->open();
+      producer.join();
+      log.wait();
+      check(capture->lines() == numbers(messages) && log.droppedMessages() == 0,
+            "a blocked producer loses nothing" + name);
+    }
+  }
+
+
+  void binaryTest() {
+    static DBG::callSite first("first.cpp", "first()", 10);
+    static DBG::callSite second("second.cpp", "second()", 20);
+
+    struct expected {
+      const DBG::callSite *site;
+      std::chrono::system_clock::time_point time;
+      uint64_t thread;
+      uint8_t verbosity;
+      uint8_t flags;
+      std::string body;
+    };
+    auto now = std::chrono::system_clock::now();
+    std::vector<expected> messages = {
+      {&first, now, 1, 0, DBG::binaryLog::TIMESTAMP | DBG::binaryLog::LOCATION, "plain"},
+      {&second, now + std::chrono::nanoseconds(1), 2, 3, DBG::binaryLog::TIMESTAMP, "two\nlines"},
+      {&first, now - std::chrono::hours(24), 3, 255, 0, std::string("embedded\0zero", 13)},
+      {&second, now, 4, 1, DBG::binaryLog::LOCATION, ""},
+    };
+
+    DBG::binaryWriter writer;
+    std::string encoded;
+    writer.begin(encoded);
+    for (auto &m : messages) {
+      writer.append(encoded, *m.site, m.time, m.thread, m.verbosity, m.flags, m.body);
+    }
+
+    std::istringstream input(encoded);
+    DBG::binaryReader reader(input);
+    check(reader.valid(), "the header is recognized");
+    DBG::binaryLog::message message;
+    for (auto &m : messages) {
+      if (!reader.next(message)) {
+        check(false, "every message is read back");
+        return;
+      }
+      const DBG::binaryLog::site &site = reader.site(message.site);
+      int64_t time = std::chrono::duration_cast<std::chrono::nanoseconds>(m.time.time_since_epoch()).count();
+      check(site.file == m.site->file && site.function == m.site->function
+              && site.line == static_cast<uint32_t>(m.site->line),
+            "the site round-trips");
+      check(message.time == time, "the time round-trips");
+      check(message.thread == m.thread && message.verbosity == m.verbosity && message.flags == m.flags,
+            "thread, verbosity and flags round-trip");
+      check(message.body == m.body, "the body round-trips");
+    }
+    check(!reader.next(message), "nothing follows the last message");
+
+    // A truncated record ends the log instead of producing a message
+    std::istringstream truncated(encoded.substr(0, encoded.size() - 2));
+    DBG::binaryReader partial(truncated);
+    size_t count = 0;
+    while (partial.next(message)) {
+      ++count;
+    }
+    check(count == messages.size() - 1, "a truncated record is not returned");
+
+    std::istringstream text("not a binary log");
+    check(!DBG::binaryReader(text).valid(), "text is not taken for a binary log");
+    // The logger records its newline setting, the decoder only ends the line if the text log would have
+    for (bool newline : {true, false}) {
+      DBG::out log("binary");
+      log.logFormat(DBG::out::LOG_FORMAT::BINARY);
+      logToFile(log, newline ? "binary_newline" : "binary");
+      log.newline(newline);
+      DBG_print_to(log, "record");
+      log.wait();
+      std::string path = log.getLogFilename();
+      log.shutdown();
+
+      std::ifstream file(path, std::ifstream::binary);
+      DBG::binaryReader logged(file);
+      check(logged.next(message) && message.body == "record"
+              && (message.flags & DBG::binaryLog::NEWLINE) == (newline ? DBG::binaryLog::NEWLINE : 0),
+            std::string("the newline flag follows the logger's setting ") + (newline ? "on" : "off"));
+    }
+  }
+
+
+
+  // The rate limiting macros log to instance()
+  void rateLimitTest() {
+    DBG::out &log = DBG::out::instance();
+    quiet(log);
+    auto capture = std::make_shared<captureSink>();
+    DBG::sinkMask mask = log.addSink(capture);
+
+    size_t evaluated = 0;
+    auto count = [&evaluated]() {
+      return ++evaluated;
+    };
+    const size_t calls = 1000;
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < calls; ++i) {
+      DBG_print_every_n(100, "every ", i, " ", count());
+      DBG_print_once("once ", i);
+      DBG_print_rate(5, "rate ", i);
+    }
+    // The calls span this many started seconds, more on a slow machine
+    auto seconds = static_cast<size_t>(
+      std::chrono::duration_cast<std::chrono::seconds>(std::chrono::steady_clock::now() - start).count() + 2);
+    log.wait();
+
+    std::vector<std::string> every;
+    std::vector<std::string> once;
+    size_t rate = 0;
+    for (auto &line : capture->lines()) {
+      if (line.compare(0, 6, "every ") == 0) {
+        every.push_back(line);
+      }
+      else if (line.compare(0, 5, "once ") == 0) {
+        once.push_back(line);
+      }
+      else if (line.compare(0, 5, "rate ") == 0) {
+        ++rate;
+      }
+    }
+    check(every.size() == calls / 100 && every[1] == "every 100 2", "every(n) passes the first of every n calls");
+    check(evaluated == calls / 100, "the arguments of suppressed calls are not evaluated");
+    check(once == std::vector<std::string>{"once 0"}, "once() passes the first call");
+    check(rate >= 1 && rate <= 5 * seconds, "rate() passes at most its limit per second");
+
+    // Reports are written at most every DBG_OUT_DROP_REPORT_MS
+    const std::string report = "suppressed ";
+    size_t expected = (calls - calls / 100) + (calls - 1) + (calls - rate);
+    size_t suppressed = 0;
+    check(waitFor([&]() {
+            suppressed = 0;
+            for (auto &line : capture->lines()) {
+              if (line.compare(0, report.size(), report) == 0) {
+                suppressed += std::stoul(line.substr(report.size()));
+              }
+            }
+            return suppressed == expected;
+          }),
+          "suppressed calls are reported, " + std::to_string(suppressed) + " of " + std::to_string(expected));
+    log.removeSink(mask);
+  }
+
+
+  void metricsTest() {
+    DBG::out log("metrics");
+    quiet(log);
+    auto capture = std::make_shared<captureSink>();
+    DBG::sinkMask mask = log.addSink(capture);
+
+    // The worker is held up so that the queue builds up
+    const size_t messages = 1000;
+    capture->close();
+    DBG_print_to(log, 0);
+    waitFor([&capture]() {
+      return capture->waiting();
+    });
+    for (size_t i = 1; i < messages; ++i) {
+      DBG_print_to(log, i);
+    }
+    check(log.getMetrics().queueDepth == messages, "the queue depth counts every waiting message");
+    capture->open();
+    log.wait();
+
+    DBG::out::metrics m = log.getMetrics();
+    check(m.enqueued == messages && m.written == messages && m.dropped == 0 && m.queueDepth == 0,
+          "enqueued, written, dropped and queue depth");
+    check(m.queueHighWater >= messages - 1 && m.queueHighWater <= messages, "the high-water mark of the queue");
+    check(m.formatNanoseconds > 0 && m.ioNanoseconds > 0, "worker time is measured");
+
+    uint64_t latencies = 0;
+    for (uint64_t bucket : m.latency) {
+      latencies += bucket;
+    }
+    check(latencies == messages, "every written message is in the latency histogram");
+
+    size_t bytes = 0;
+    for (auto &line : numbers(messages)) {
+      bytes += line.size() + 1;
+    }
+    bool found = false;
+    for (auto &sink : m.sinks) {
+      if (sink.sink == DBG::SINK_OS || sink.sink == DBG::SINK_OFS) {
+        check(sink.messages == 0 && sink.bytes == 0, "disabled outputs write nothing");
+      }
+      else if (sink.sink == mask) {
+        found = true;
+        check(sink.messages == messages && sink.bytes == bytes && sink.dropped == 0, "the sink's messages and bytes");
+      }
+    }
+    check(found && m.sinks.size() == 3, "std::cerr, the log file and the registered sink are listed");
+
+    // Dropped messages are counted as well
+    log.queueCapacity(1, DBG::out::OVERFLOW_POLICY::DROP_NEWEST);
+    capture->close();
+    DBG_print_to(log, "blocked");
+    waitFor([&capture]() {
+      return capture->waiting();
+    });
+    DBG_print_to(log, "dropped");
+    capture->open();
+    log.wait();
+    m = log.getMetrics();
+    check(m.enqueued == messages + 1 && m.dropped == 1 && m.dropped == log.droppedMessages(), "dropped messages");
+  }
+
+
+  // Queues aMessages while the worker is held up, then shuts the logger down
+  std::vector<std::string> shutdownWith(size_t aTimeout, size_t aMessages, size_t &_dropped) {
+    DBG::out log("shutdown_" + std::to_string(aTimeout));
+    quiet(log);
+    log.shutdownTimeout(aTimeout);
+    auto capture = std::make_shared<captureSink>();
+    log.addSink(capture);
+
+    capture->close();
+    DBG_print_to(log, 0);
+    waitFor([&capture]() {
+      return capture->waiting();
+    });
+    for (size_t i = 1; i < aMessages; ++i) {
+      DBG_print_to(log, i);
+    }
+
+    std::thread stopper([&log]() {
+      log.shutdown();
+    });
+    // shutdown() stops the worker before it waits for it, the delay lets it get there
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    capture->open();
+    stopper.join();
+
+    _dropped = log.droppedMessages();
+    return capture->lines();
+  }
+
+
+  void shutdownTest() {
+    const size_t messages = 1000;
+    size_t dropped = 0;
+    check(shutdownWith(1000, messages, dropped) == numbers(messages) && dropped == 0,
+          "shutdown writes the queued messages");
+
+    // Only the batch the worker was writing gets out
+    check(shutdownWith(0, messages, dropped) == numbers(1) && dropped == messages - 1,
+          "a timeout of 0 discards the queue and counts it as dropped");
+  }
+
+
+  // True if aLine is aPrefix, something and then aSuffix
+  bool framed(const std::string &aLine, const std::string &aPrefix, const std::string &aSuffix) {
+    return aLine.size() > aPrefix.size() + aSuffix.size() && aLine.compare(0, aPrefix.size(), aPrefix) == 0
+           && aLine.compare(aLine.size() - aSuffix.size(), aSuffix.size(), aSuffix) == 0;
+  }
+
+
+  void scopeTest() {
+    DBG::out log("scope");
+    quiet(log);
+    auto capture = std::make_shared<captureSink>();
+    log.addSink(capture);
+
+    // Two scopes on one line, and one in the init-statement of an if
+    { DBG_scope_to(log, "outer"); DBG_scope_to(log, "inner"); }
+    if (DBG_scope_to(log, "if"); log.enabled()) {
+    }
+    log.wait();
+    std::vector<std::string> lines = capture->lines();
+    check(lines.size() == 3 && framed(lines[0], "inner took ", " us") && framed(lines[1], "outer took ", " us")
+            && framed(lines[2], "if took ", " us"),
+          "scopes are logged when they end");
+
+    // Trace events go to the trace sink only
+    auto trace = std::make_shared<captureSink>();
+    DBG::sinkMask traceMask = log.traceSink(trace);
+    {
+      DBG_scope_to(log, "traced");
+    }
+    log.wait();
+    lines = trace->lines();
+    check(traceMask != 0 && lines.size() == 2 && lines[0] == "["
+            && framed(lines[1], "{\"name\":\"traced\",\"ph\":\"X\",\"ts\":", "},")
+            && lines[1].find(",\"dur\":") != std::string::npos,
+          "trace events");
+    check(capture->lines().size() == 3, "the other sinks do not get trace events");
+
+    // With every bit taken the trace sink can still be replaced, its bit is reused
+    std::vector<DBG::sinkMask> fillers;
+    for (DBG::sinkMask mask = 1; mask != 0;) {
+      mask = log.addSink(std::make_shared<captureSink>());
+      fillers.push_back(mask);
+    }
+    fillers.pop_back();
+    auto replacement = std::make_shared<captureSink>();
+    check(log.traceSink(replacement) == traceMask, "replacing the trace sink when every bit is taken");
+
+    // Without a trace sink to replace it fails and changes nothing
+    log.removeSink(traceMask);
+    fillers.push_back(log.addSink(std::make_shared<captureSink>()));
+    auto rejected = std::make_shared<captureSink>();
+    check(log.traceSink(rejected) == 0 && rejected->lines().empty(), "a trace sink which does not fit is not used");
+    {
+      DBG_scope_to(log, "text");
+    }
+    log.wait();
+    lines = capture->lines();
+    check(lines.size() == 4 && framed(lines[3], "text took ", " us"), "scopes are still logged as text");
+
+    for (DBG::sinkMask mask : fillers) {
+      log.removeSink(mask);
+    }
+  }
+
+
+  void flightRecorderTest() {
+    DBG::out log("flight_recorder");
+    logToFile(log, "flight_recorder");
+    // dump() writes to the log file once it is open
+    DBG_print_to(log, "opened");
+    log.wait();
+    std::string path = log.getLogFilename();
+
+    log.queueMode(DBG::out::QUEUE_MODE::FLIGHT_RECORDER);
+    const size_t overwritten = 500;
+    const size_t messages = DBG_OUT_FLIGHT_RECORDER_SIZE + overwritten;
+    for (size_t i = 0; i < messages; ++i) {
+      DBG_print_to(log, i);
+    }
+    log.wait();
+    check(fileLines(path) == std::vector<std::string>{"opened"}, "recorded messages are not written");
+
+    check(log.dump() == DBG_OUT_FLIGHT_RECORDER_SIZE, "the recorder keeps the newest messages");
+    std::vector<std::string> expected{"opened"};
+    for (size_t i = overwritten; i < messages; ++i) {
+      expected.push_back(std::to_string(i));
+    }
+    check(fileLines(path) == expected, "dump() writes the newest messages oldest first");
+    check(log.dump() == 0, "the recorder is empty after dump()");
+
+    DBG_print_to(log, "again");
+    check(log.dump() == 1, "messages recorded after dump()");
+    expected.push_back("again");
+    check(fileLines(path) == expected, "a second dump() is appended");
+  }
+
+
+  void aioTest() {
+    {
+      DBG::out log("aio");
+      logToFile(log, "aio");
+      check(log.fileMode(DBG::out::FILE_MODE::AIO), "the AIO backend is selected");
+      const size_t messages = 100000;
+      for (size_t i = 0; i < messages; ++i) {
+        DBG_print_to(log, i);
+      }
+      log.wait();
+      check(log.fileMode() == DBG::out::FILE_MODE::AIO, "the log file is written by AIO");
+      std::string path = log.getLogFilename();
+      check(fileLines(path) == numbers(messages), "wait() waits for the writes in flight");
+      log.shutdown();
+    }
+
+    // Every backend appends to the same file
+    {
+      DBG::out log("aio_switch");
+      logToFile(log, "aio_switch");
+      const DBG::out::FILE_MODE modes[]
+        = {DBG::out::FILE_MODE::AIO, DBG::out::FILE_MODE::MMAP, DBG::out::FILE_MODE::STREAM};
+      size_t messages = 0;
+      DBG_print_to(log, messages++);
+      log.wait();
+      std::string path = log.getLogFilename();
+      for (auto mode : modes) {
+        check(log.fileMode(mode), "the backend is switched while the file is open");
+        for (size_t i = 0; i < 1000; ++i) {
+          DBG_print_to(log, messages++);
+        }
+        log.wait();
+      }
+      log.shutdown();
+      check(fileLines(path) == numbers(messages), "switching backends keeps every message in order");
+      check(contents(path).find('\0') == std::string::npos, "no zero bytes are left between the backends");
+    }
+
+    // More writes than buffers, each waits for the oldest buffer to come back
+    std_filesystem::create_directories(directory("aio_file"));
+    std::string path = directory("aio_file") + "/small.log";
+    DBG::asyncFile file;
+    check(file.open(path, 7, 2), "small buffers");
+    std::string expected;
+    for (auto &line : numbers(1000)) {
+      expected += line + "\n";
+      check(file.write(line.data(), line.size()) && file.write("\n", 1), "writes succeed");
+    }
+    check(file.size() == expected.size(), "the size includes the writes in flight");
+    file.close();
+    check(contents(path) == expected, "the buffers are written in order");
+
+#ifdef DBG_TEST_HAS_RLIMIT
+    // A write beyond the file size limit fails in the kernel, which is reported by a later write
+    check(file.open(directory("aio_file") + "/limited.log", 16, 2), "reopened");
+    struct rlimit limit;
+    getrlimit(RLIMIT_FSIZE, &limit);
+    struct rlimit restore = limit;
+    limit.rlim_cur = 64;
+    auto handler = std::signal(SIGXFSZ, SIG_IGN);
+    setrlimit(RLIMIT_FSIZE, &limit);
+    bool failed = false;
+    for (size_t i = 0; i < 100 && !failed; ++i) {
+      failed = !file.write("0123456789abcdef", 16);
+    }
+    file.close();
+    setrlimit(RLIMIT_FSIZE, &restore);
+    std::signal(SIGXFSZ, handler);
+    check(failed, "a failed write is reported");
+#endif
+  }
+
+
+  void poolTest() {
+    auto pool = std::make_shared<DBG::workerPool>(2);
+    check(pool->size() == 2 && !DBG::workerPool::onPoolThread(), "pool threads");
+    auto blocked = std::make_shared<captureSink>();
+    auto written = std::make_shared<captureSink>();
+    {
+      DBG::out stuck("pool_stuck", pool);
+      DBG::out running("pool_running", pool);
+      quiet(stuck);
+      quiet(running);
+      stuck.addSink(blocked);
+      running.addSink(written);
+
+      blocked->close();
+      DBG_print_to(stuck, "stuck");
+      check(waitFor([&blocked]() {
+              return blocked->waiting();
+            }),
+            "a pool thread reaches the closed sink");
+
+      // A logger which is held up does not hold up the other threads
+      const size_t messages = 10000;
+      for (size_t i = 0; i < messages; ++i) {
+        DBG_print_to(running, i);
+      }
+      check(waitFor([&running]() {
+              return running.remainingMessages() == 0;
+            }),
+            "the other pool thread writes the second logger");
+
+      blocked->open();
+      stuck.wait();
+      running.wait();
+      check(written->lines() == numbers(messages), "the second logger's messages are written in order");
+      check(blocked->lines().size() == 1, "the blocked logger finishes once its sink is open");
+    }
+  }
+
+
+#ifdef DBG_TEST_HAS_SOCKETS
+  // Binds a loopback socket of aType to a free port
+  int collector(int aType, uint16_t &_port) {
+    int fd = socket(AF_INET, aType, 0);
+    sockaddr_in address{};
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t size = sizeof(address);
+    if (fd < 0 || bind(fd, reinterpret_cast<sockaddr *>(&address), size) != 0
+        || getsockname(fd, reinterpret_cast<sockaddr *>(&address), &size) != 0
+        || (aType == SOCK_STREAM && listen(fd, 1) != 0)) {
+      return -1;
+    }
+    _port = ntohs(address.sin_port);
+    return fd;
+  }
+#endif
+
+
+  void networkTest() {
+#ifdef DBG_TEST_HAS_SOCKETS
+    const size_t messages = 1000;
+
+    // Text over TCP, the connection is closed when the sink is destroyed
+    uint16_t port = 0;
+    int server = collector(SOCK_STREAM, port);
+    check(server >= 0, "the TCP collector listens");
+    std::string received;
+    std::thread reader([server, &received]() {
+      int connection = accept(server, nullptr, nullptr);
+      char data[4096];
+      ssize_t size;
+      while (connection >= 0 && (size = recv(connection, data, sizeof(data), 0)) > 0) {
+        received.append(data, static_cast<size_t>(size));
+      }
+      close(connection);
+    });
+    {
+      auto tcp = std::make_shared<DBG::networkSink>("127.0.0.1", port);
+      {
+        DBG::out log("network_tcp");
+        quiet(log);
+        log.addSink(tcp);
+        for (size_t i = 0; i < messages; ++i) {
+          DBG_print_to(log, i);
+        }
+      }
+      tcp->wait();
+      check(tcp->dropped() == 0, "nothing is dropped over TCP");
+    }
+    reader.join();
+    close(server);
+    check(splitLines(received) == numbers(messages), "text over TCP");
+
+    // Binary over UDP, every datagram decodes on its own
+    server = collector(SOCK_DGRAM, port);
+    check(server >= 0, "the UDP collector is bound");
+    struct timeval timeout = {1, 0};
+    setsockopt(server, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+    // Records which do not fit a datagram are dropped, the first one is also the first of its datagram
+    const std::string oversized(2 * DBG_OUT_NETWORK_DATAGRAM_SIZE, 'x');
+    auto udp = std::make_shared<DBG::networkSink>(
+      "127.0.0.1", port, DBG::networkSink::PROTOCOL::UDP, DBG::networkSink::FORMAT::BINARY);
+    {
+      DBG::out log("network_udp");
+      quiet(log);
+      log.addSink(udp);
+      DBG_print_to(log, oversized);
+      for (size_t i = 0; i < messages; ++i) {
+        DBG_print_to(log, i);
+        if (i == messages / 2) {
+          DBG_print_to(log, oversized);
+        }
+      }
+    }
+    udp->wait();
+    check(udp->dropped() == 2 * oversized.size(), "only the text of the dropped records is counted");
+
+    std::vector<std::string> bodies;
+    bool empty = false;
+    bool small = true;
+    char datagram[65536];
+    ssize_t size;
+    while ((size = recv(server, datagram, sizeof(datagram), 0)) > 0) {
+      small = small && static_cast<size_t>(size) <= DBG_OUT_NETWORK_DATAGRAM_SIZE;
+      std::istringstream input(std::string(datagram, static_cast<size_t>(size)));
+      DBG::binaryReader reader(input);
+      DBG::binaryLog::message message;
+      size_t count = 0;
+      while (reader.valid() && reader.next(message)) {
+        bodies.push_back(message.body);
+        ++count;
+      }
+      empty = empty || count == 0;
+    }
+    close(server);
+    check(small && !empty, "every datagram fits and holds at least one record");
+    check(bodies == numbers(messages), "binary over UDP");
+
+    // Without a collector the port is unreachable and a later send fails
+    server = collector(SOCK_DGRAM, port);
+    close(server);
+    auto unreachable = std::make_shared<DBG::networkSink>(
+      "127.0.0.1", port, DBG::networkSink::PROTOCOL::UDP, DBG::networkSink::FORMAT::BINARY);
+    {
+      DBG::out log("network_unreachable");
+      quiet(log);
+      log.addSink(unreachable);
+      const std::string message(100, 'y');
+      for (size_t i = 0; i < 100 && unreachable->dropped() == 0; ++i) {
+        DBG_print_to(log, message);
+        log.wait();
+        unreachable->wait();
+      }
+      check(unreachable->dropped() != 0 && unreachable->dropped() % message.size() == 0,
+            "a failed send counts the text of its records");
+    }
+#endif
+  }
+
+
+  void configTest() {
+    DBG::out log("config");
+    quiet(log);
+    check(log.configure("verbosity=4, timestamp=on; location=true") && log.verbosity() == 4
+            && log.configuration().timestamp && log.configuration().location,
+          "pairs separated by whitespace, ',' and ';'");
+    check(!log.configure("verbosity=5 unknown=1") && log.verbosity() == 4, "nothing is applied if a key is unknown");
+    check(!log.configure("verbosity") && !log.configure("verbosity=256"), "invalid pairs are rejected");
+    quiet(log);
+
+    // A directory with separators or '#' is quoted, and the log file is created in it
+    std::string dir = directory("config") + "/with space#1";
+    check(log.configure("directory=\"" + dir + "\" ofs=1 # comment") && log.configuration().logDirectory == dir,
+          "a quoted value keeps its separators");
+    check(!log.configure("directory=\"" + dir) && !log.configure("directory=a\"b\""), "unbalanced quotes");
+    DBG_print_to(log, "quoted");
+    log.wait();
+    std::string logFile = log.getLogFilename();
+    check(std_filesystem::path(logFile).parent_path() == std_filesystem::path(dir)
+            && fileLines(logFile) == std::vector<std::string>{"quoted"},
+          "the log file is in the quoted directory");
+    log.configure("ofs=0");
+
+    std::string path = directory("config") + "/DBG_test.cfg";
+    std::ofstream(path) << "verbosity=3\n";
+    log.watchConfig(path, 10);
+    check(waitFor([&log]() {
+            return log.verbosity() == 3;
+          }),
+          "the file is applied when watching starts");
+
+    std::ofstream(path) << "verbosity=12 # changed\n";
+    check(waitFor([&log]() {
+            return log.verbosity() == 12;
+          }),
+          "a change to the file is applied");
+
+    std::ofstream(path) << "verbosity=unknown\n";
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    check(log.verbosity() == 12, "an invalid file changes nothing");
+
+    log.watchConfig(std::string());
+    std::ofstream(path) << "verbosity=1\n";
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    check(log.verbosity() == 12, "the file is not applied after watching stops");
+  }
+
+
+  void captureTest() {
+    // A string which does not fit inline is taken over by an empty buffer, moving the buffer keeps it
+    std::string text(DBG_OUT_MESSAGE_SIZE * 2, 'm');
+    const char *data = text.data();
+    DBG::messageBuffer buffer;
+    DBG::format(buffer, std::move(text));
+    check(buffer.view().data() == data && buffer.size() == DBG_OUT_MESSAGE_SIZE * 2,
+          "a moved string is taken over instead of copied");
+    DBG::messageBuffer moved(std::move(buffer));
+    check(moved.view().data() == data && buffer.size() == 0, "moving a buffer keeps its string");
+
+    std::string kept(DBG_OUT_MESSAGE_SIZE * 2, 'k');
+    DBG::messageBuffer copied;
+    DBG::format(copied, kept);
+    check(copied.view() == kept && copied.view().data() != kept.data(), "a string lvalue is copied");
+
+    // Moved strings, views and C strings reach the sinks unchanged
+    DBG::out log("capture");
+    quiet(log);
+    auto capture = std::make_shared<captureSink>();
+    log.addSink(capture);
+
+    std::string large(DBG_OUT_MESSAGE_SIZE * 2, 'x');
+    std::string expected = large;
+    std::string_view view("view");
+    const char *str = "c string";
+    DBG_print_to(log, std::move(large));
+    DBG_print_to(log, view, " ", str, " ", std::string("short"), " ", kept.substr(0, 4));
+    log.wait();
+
+    std::vector<std::string> lines = capture->lines();
+    check(lines.size() == 2 && lines[0] == expected, "a moved string is written");
+    check(lines.size() == 2 && lines[1] == "view c string short kkkk", "views and C strings are written");
+  }
+}  // namespace
+
+
+int main(int argc, char **argv) {
+  struct test {
+    const char *name;
+    void (*run)();
+  };
+  const test tests[] = {{"ring", ringTest},
+                        {"order", orderTest},
+                        {"thread_buffer", threadBufferTest},
+                        {"format", formatTest},
+                        {"deferred", deferredTest},
+                        {"timestamp", timestampTest},
+                        {"max_verbosity", maxVerbosityTest},
+                        {"mmap", mmapTest},
+                        {"rotation", rotationTest},
+                        {"sink", sinkTest},
+                        {"overflow", overflowTest},
+                        {"binary", binaryTest},
+                        {"rate_limit", rateLimitTest},
+                        {"metrics", metricsTest},
+                        {"shutdown", shutdownTest},
+                        {"scope", scopeTest},
+                        {"flight_recorder", flightRecorderTest},
+                        {"aio", aioTest},
+                        {"pool", poolTest},
+                        {"network", networkTest},
+                        {"config", configTest},
+                        {"capture", captureTest}};
+
+  std::error_code error;
+  std_filesystem::remove_all(std_filesystem::temp_directory_path() / "DBG_test", error);
+
+  size_t failed = 0;
+  for (auto &t : tests) {
+    bool selected = argc == 1;
+    for (int i = 1; i < argc; ++i) {
+      selected = selected || std::string(argv[i]) == t.name;
+    }
+    if (!selected) {
+      continue;
+    }
+
+    size_t before = failures;
+    t.run();
+    std::cout << t.name << (failures == before ? ": ok\n" : ": FAILED\n");
+    failed += failures != before;
+  }
+  return static_cast<int>(failed);
+}
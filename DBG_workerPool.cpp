@@ -0,0 +1,227 @@
+/**
+* @Filename: DBG_workerPool.cpp
+* @Author:   Ben Sokol <Ben>
+* @Email:    ben@bensokol.com
+* @Created:  October 14th, 2026 [4:05pm]
+* @Modified: October 14th, 2026 [4:05pm]
+* @Version:  1.0.0
+*
+* Copyright (C) 2019 by Ben Sokol. All Rights Reserved.
+*/
+
+#include <cstddef>  // size_t
+#include <cstdint>  // SIZE_MAX
+
+#include <algorithm>  // std::max, std::find
+#include <chrono>     // std::chrono::steady_clock
+#include <mutex>      // std::mutex, std::unique_lock
+#include <thread>     // std::thread
+#include <vector>     // std::vector
+
+#include "DBG_out.hpp"
+#include "DBG_workerPool.hpp"
+
+#if defined(__linux__)
+  #include <pthread.h>  // pthread_setaffinity_np, pthread_setschedparam
+  #include <sched.h>    // cpu_set_t, SCHED_BATCH, SCHED_IDLE
+#endif
+
+namespace DBG {
+  namespace {
+    // Index of the calling thread in its pool, or SIZE_MAX
+    thread_local size_t tPoolIndex = SIZE_MAX;
+    thread_local const workerPool *tPool = nullptr;
+  }  // namespace
+
+
+  workerPool::workerPool(size_t aThreads) :
+      mNext(0),
+      mReady(0),
+      mStop(false),
+      mLastTick(std::chrono::steady_clock::now()) {
+    aThreads = std::max<size_t>(aThreads, 1);
+    for (size_t i = 0; i < aThreads; ++i) {
+      mWorkers.emplace_back(new worker());
+    }
+    // Started once every queue exists, any thread may steal from any other
+    for (size_t i = 0; i < aThreads; ++i) {
+      mWorkers[i]->thread = std::thread(&workerPool::workerThread, this, i);
+    }
+  }
+
+
+  workerPool::~workerPool() {
+    {
+      std::unique_lock<std::mutex> lock(mMutex);
+      mStop = true;
+    }
+    mCondition.notify_all();
+
+    for (auto &w : mWorkers) {
+      if (w->thread.joinable()) {
+        w->thread.join();
+      }
+    }
+  }
+
+
+  size_t workerPool::size() const {
+    return mWorkers.size();
+  }
+
+
+  bool workerPool::affinity(const std::vector<size_t> &aCPUs) {
+#if defined(__linux__)
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (size_t cpu : aCPUs) {
+      if (cpu >= CPU_SETSIZE) {
+        return false;
+      }
+      CPU_SET(cpu, &set);
+    }
+
+    bool result = !aCPUs.empty();
+    for (auto &w : mWorkers) {
+      result = pthread_setaffinity_np(w->thread.native_handle(), sizeof(set), &set) == 0 && result;
+    }
+    return result;
+#else
+    (void)aCPUs;
+    return false;
+#endif
+  }
+
+
+  bool workerPool::priority(PRIORITY aPriority) {
+#if defined(__linux__)
+    int policy = SCHED_OTHER;
+    if (aPriority == PRIORITY::LOW) {
+      policy = SCHED_BATCH;
+    }
+    else if (aPriority == PRIORITY::IDLE) {
+      policy = SCHED_IDLE;
+    }
+
+    sched_param param{};
+    bool result = true;
+    for (auto &w : mWorkers) {
+      result = pthread_setschedparam(w->thread.native_handle(), policy, &param) == 0 && result;
+    }
+    return result;
+#else
+    (void)aPriority;
+    return false;
+#endif
+  }
+
+
+  bool workerPool::onPoolThread() {
+    return tPool != nullptr;
+  }
+
+
+  void workerPool::attach(out *aLogger) {
+    std::unique_lock<std::mutex> lock(mLoggersMutex);
+    mLoggers.push_back(aLogger);
+  }
+
+
+  void workerPool::detach(out *aLogger) {
+    std::unique_lock<std::mutex> lock(mLoggersMutex);
+    auto it = std::find(mLoggers.begin(), mLoggers.end(), aLogger);
+    if (it != mLoggers.end()) {
+      mLoggers.erase(it);
+    }
+  }
+
+
+  void workerPool::schedule(out *aLogger) {
+    // Keep the logger on the calling pool thread if there is one, it has the logger's state in its cache
+    size_t index = tPool == this ? tPoolIndex : mNext.fetch_add(1, std::memory_order_relaxed) % mWorkers.size();
+    {
+      std::unique_lock<std::mutex> lock(mWorkers[index]->mutex);
+      mWorkers[index]->ready.push_back(aLogger);
+    }
+
+    {
+      std::unique_lock<std::mutex> lock(mMutex);
+      mReady.fetch_add(1, std::memory_order_relaxed);
+    }
+    mCondition.notify_one();
+  }
+
+
+  out *workerPool::take(size_t aIndex) {
+    out *logger = nullptr;
+    for (size_t i = 0; i < mWorkers.size() && logger == nullptr; ++i) {
+      worker &w = *mWorkers[(aIndex + i) % mWorkers.size()];
+      std::unique_lock<std::mutex> lock(w.mutex);
+      if (w.ready.empty()) {
+        continue;
+      }
+      if (i == 0) {
+        logger = w.ready.front();
+        w.ready.pop_front();
+      }
+      else {
+        logger = w.ready.back();
+        w.ready.pop_back();
+      }
+    }
+
+    if (logger != nullptr) {
+      std::unique_lock<std::mutex> lock(mMutex);
+      mReady.fetch_sub(1, std::memory_order_relaxed);
+    }
+    return logger;
+  }
+
+
+  void workerPool::tick() {
+    std::unique_lock<std::mutex> lock(mLoggersMutex);
+    for (out *logger : mLoggers) {
+      logger->notifyWorker();
+    }
+  }
+
+
+  void workerPool::workerThread(size_t aIndex) {
+    tPool = this;
+    tPoolIndex = aIndex;
+    const auto tickPeriod = std::chrono::milliseconds(DBG_OUT_POOL_TICK_MS);
+
+    for (;;) {
+      out *logger = take(aIndex);
+      if (logger != nullptr) {
+        // Requeued at the back so that other loggers, and threads stealing them, get a turn
+        if (logger->poolRun()) {
+          schedule(logger);
+        }
+        continue;
+      }
+
+      bool due = false;
+      {
+        std::unique_lock<std::mutex> lock(mMutex);
+        mCondition.wait_until(lock, mLastTick + tickPeriod, [this]() {
+          return mStop || mReady.load(std::memory_order_relaxed) != 0;
+        });
+        if (mStop) {
+          return;
+        }
+
+        // Only one thread runs each tick
+        auto now = std::chrono::steady_clock::now();
+        if (now - mLastTick >= tickPeriod) {
+          mLastTick = now;
+          due = true;
+        }
+      }
+
+      if (due) {
+        tick();
+      }
+    }
+  }
+}  // namespace DBG
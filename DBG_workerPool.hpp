@@ -0,0 +1,107 @@
+/**
+* @Filename: DBG_workerPool.hpp
+* @Author:   Ben Sokol <Ben>
+* @Email:    ben@bensokol.com
+* @Created:  October 14th, 2026 [4:05pm]
+* @Modified: October 14th, 2026 [4:05pm]
+* @Version:  1.0.0
+*
+* Copyright (C) 2019 by Ben Sokol. All Rights Reserved.
+*/
+
+#ifndef DBG_WORKER_POOL_HPP
+#define DBG_WORKER_POOL_HPP
+
+#include <cstddef>  // size_t
+
+#include <atomic>              // std::atomic
+#include <chrono>              // std::chrono::steady_clock
+#include <condition_variable>  // std::condition_variable
+#include <deque>               // std::deque
+#include <memory>              // std::unique_ptr
+#include <mutex>               // std::mutex
+#include <thread>              // std::thread
+#include <vector>              // std::vector
+
+// Batches a pool thread writes for one logger before moving on to the next
+#ifndef DBG_OUT_POOL_BATCHES
+  #define DBG_OUT_POOL_BATCHES 4
+#endif
+
+// Interval at which idle loggers are visited for timed work (thread buffers, interval flushes, drop reports)
+#ifndef DBG_OUT_POOL_TICK_MS
+  #define DBG_OUT_POOL_TICK_MS 100
+#endif
+
+namespace DBG {
+  class out;
+
+  // Threads shared by any number of DBG::out instances in place of one worker each.
+  // A logger with work is queued on one thread and runs on a single thread at a time, so its messages stay in
+  // order. Idle threads steal queued loggers from busy ones. Pass the pool to out::instance(name, pool).
+  class workerPool {
+  public:
+    enum class PRIORITY {
+      NORMAL,  // SCHED_OTHER
+      LOW,     // SCHED_BATCH
+      IDLE     // SCHED_IDLE, only runs when the CPU would otherwise be idle
+    };
+
+    explicit workerPool(size_t aThreads = 1);
+
+    // Every logger using the pool must have been destroyed or shut down
+    ~workerPool();
+
+    workerPool(const workerPool &) = delete;
+    workerPool &operator=(const workerPool &) = delete;
+
+    size_t size() const;
+
+    // Restricts every pool thread to aCPUs, returns false if unsupported or rejected by the system
+    bool affinity(const std::vector<size_t> &aCPUs);
+
+    // Scheduling policy of every pool thread, returns false if unsupported or rejected by the system
+    bool priority(PRIORITY aPriority);
+
+    // True if called on a thread of any workerPool
+    static bool onPoolThread();
+
+  private:
+    friend class out;
+
+    struct worker {
+      std::mutex mutex;
+      std::deque<out *> ready;  // Loggers with work, taken from the front and stolen from the back
+      std::thread thread;
+    };
+
+    // Called by out when it starts and after its final drain
+    void attach(out *aLogger);
+    void detach(out *aLogger);
+
+    // Queues a logger which has work, each logger is queued at most once
+    void schedule(out *aLogger);
+
+    void workerThread(size_t aIndex);
+
+    // Pops from aIndex's queue, or steals from another thread
+    out *take(size_t aIndex);
+
+    // Wakes idle loggers for their timed work
+    void tick();
+
+    std::vector<std::unique_ptr<worker>> mWorkers;
+    std::atomic<size_t> mNext;   // Round robin target for schedule() from other threads
+    std::atomic<size_t> mReady;  // Loggers queued on any thread
+
+    std::vector<out *> mLoggers;
+    std::mutex mLoggersMutex;
+
+    bool mStop;
+    std::chrono::steady_clock::time_point mLastTick;
+    std::mutex mMutex;
+    std::condition_variable mCondition;
+  };
+}  // namespace DBG
+
+#endif